@@ -32,6 +32,7 @@ namespace ejdi::ast {
     struct NumberLiteral;
     struct BoolLiteral;
     struct ArrayLiteral;
+    struct ObjectLiteral;
     struct FunctionLiteral;
 
 
@@ -52,6 +53,7 @@ namespace ejdi::ast {
         Rc<NumberLiteral>,
         Rc<BoolLiteral>,
         Rc<ArrayLiteral>,
+        Rc<ObjectLiteral>,
         Rc<FunctionLiteral>
     >;
 
@@ -220,6 +222,21 @@ namespace ejdi::ast {
         span::Span span() const;
     };
 
+    struct ObjectField {
+        lexer::Word name;
+        lexer::Punct colon;
+        Expr value;
+    };
+
+    // `{ name: expr, ... }`. Braces starting with `word :` are an object
+    // literal, anything else is a block.
+    struct ObjectLiteral {
+        Rc<List<ObjectField>> fields;
+
+        std::string debug(std::size_t depth = 0) const;
+        span::Span span() const;
+    };
+
     struct FunctionLiteral {
         lexer::Word func;
         Rc<List<lexer::Word>> argnames;
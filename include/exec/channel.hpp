@@ -0,0 +1,163 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <memory>
+#include <optional>
+#include <cstdint>
+
+#include <exec/value.hpp>
+#include <exec/isolate.hpp>
+
+namespace ejdi::exec::channel {
+    // Bounded multi-producer multi-consumer queue (Vyukov). Every cell
+    // carries a sequence number telling producers and consumers whose turn
+    // it is, so neither side ever takes a lock.
+    template< typename T >
+    class MpmcQueue {
+        struct Cell {
+            std::atomic<std::size_t> sequence;
+            std::optional<T> data;
+        };
+
+        std::unique_ptr<Cell[]> cells;
+        std::size_t mask;
+
+        alignas(64) std::atomic<std::size_t> enqueue_pos { 0 };
+        alignas(64) std::atomic<std::size_t> dequeue_pos { 0 };
+
+    public:
+        explicit MpmcQueue(std::size_t capacity) {
+            std::size_t size = 2;
+            while (size < capacity) {
+                size *= 2;
+            }
+
+            cells = std::make_unique<Cell[]>(size);
+            mask = size - 1;
+            for (std::size_t i = 0; i < size; i++) {
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        std::size_t capacity() const {
+            return mask + 1;
+        }
+
+        // A hint for parking: a slot that is half-way through a push counts
+        // as empty, and the producer holding it wakes the receivers.
+        bool empty() const {
+            auto pos = dequeue_pos.load(std::memory_order_relaxed);
+            auto seq = cells[pos & mask].sequence.load(std::memory_order_acquire);
+            return (std::intptr_t)seq - (std::intptr_t)(pos + 1) < 0;
+        }
+
+        // Moves `value` into the queue unless it is full.
+        bool try_push(T& value) {
+            Cell* cell;
+            auto pos = enqueue_pos.load(std::memory_order_relaxed);
+            while (true) {
+                cell = &cells[pos & mask];
+                auto seq = cell->sequence.load(std::memory_order_acquire);
+                auto diff = (std::intptr_t)seq - (std::intptr_t)pos;
+                if (diff == 0) {
+                    if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = enqueue_pos.load(std::memory_order_relaxed);
+                }
+            }
+
+            cell->data = std::move(value);
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        std::optional<T> try_pop() {
+            Cell* cell;
+            auto pos = dequeue_pos.load(std::memory_order_relaxed);
+            while (true) {
+                cell = &cells[pos & mask];
+                auto seq = cell->sequence.load(std::memory_order_acquire);
+                auto diff = (std::intptr_t)seq - (std::intptr_t)(pos + 1);
+                if (diff == 0) {
+                    if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return std::nullopt;
+                } else {
+                    pos = dequeue_pos.load(std::memory_order_relaxed);
+                }
+            }
+
+            std::optional<T> ret;
+            ret.swap(cell->data);
+            cell->sequence.store(pos + mask + 1, std::memory_order_release);
+            return ret;
+        }
+    };
+
+
+    // A bounded channel on an MpmcQueue. The ring is rounded up to a power
+    // of two; `held` keeps the channel to the capacity asked for. Blocked
+    // calls spin for a while and then park on a condition variable.
+    class Channel : public value::Native {
+        MpmcQueue<isolate::Message> queue;
+        std::size_t capacity_;
+
+        // Messages in the queue plus pushes under way. A send claims its
+        // place here before pushing, a receive gives it back after popping,
+        // so the ring always has room for every claim.
+        std::atomic<std::size_t> held { 0 };
+
+        // Bit 0 is set by close(); the rest counts sends that are in the
+        // middle of a push. Once it reads exactly CLOSED no message can be
+        // added any more.
+        std::atomic<std::size_t> state { 0 };
+
+        std::mutex mutex;
+        std::condition_variable readable;
+        std::condition_variable writable;
+        std::atomic<std::size_t> waiting_receivers { 0 };
+        std::atomic<std::size_t> waiting_senders { 0 };
+
+        bool claim();
+        void wake(std::condition_variable& cv, std::atomic<std::size_t>& waiting, bool all);
+        template< typename Ready >
+        void park(std::condition_variable& cv, std::atomic<std::size_t>& waiting, Ready ready);
+
+    public:
+        static constexpr std::string_view NAME = "channel";
+        // The queue is allocated up front, rounded up to a power of two.
+        static constexpr std::size_t MAX_CAPACITY = std::size_t(1) << 24;
+
+        explicit Channel(std::size_t capacity) : queue(capacity), capacity_(capacity) {}
+
+        std::string_view type_name() const override;
+        std::string_view vtable_name() const override;
+        std::shared_ptr<value::Native> transfer(const std::shared_ptr<value::Native>& self, const value::CopyValue&) const override;
+        bool shareable() const override;
+
+        std::size_t capacity() const;
+
+        // Blocks while the channel is full. Returns false if it is closed.
+        bool send(isolate::Message message);
+        // False if the channel is full or closed; `message` is left alone.
+        bool try_send(isolate::Message& message);
+        // Blocks while the channel is empty. Returns nullopt once it is
+        // closed and drained: close() stops new sends, and recv() waits
+        // for the ones already under way.
+        std::optional<isolate::Message> recv();
+        std::optional<isolate::Message> try_recv();
+
+        void close();
+        bool is_closed() const;
+    };
+
+    value::Value prototype();
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <exec/value.hpp>
+
+namespace ejdi::exec::collections {
+    // Open addressing with linear probing, keyed by numbers, strings and
+    // booleans. Entries are stored densely in a vector; a slot holds the top
+    // 32 bits of the key's hash and the index of its entry, so a probe only
+    // touches the entry when the hashes match.
+    class HashTable {
+    public:
+        struct Entry {
+            value::Value key;
+            value::Value value;
+            std::uint64_t hash;
+        };
+
+    private:
+        std::vector<Entry> entries_;
+        std::vector<std::uint64_t> slots;
+
+        std::size_t mask() const;
+        std::size_t find_slot(context::Context& ctx, value::Value& key, std::uint64_t hash);
+        void rehash(std::size_t capacity);
+        void place(std::uint64_t hash, std::size_t index);
+
+    public:
+        std::size_t size() const;
+        void reserve(std::size_t size);
+        void clear();
+
+        /*nullable*/ Entry* find(context::Context& ctx, value::Value& key);
+        // Returns the entry for `key`, adding one with a () value if needed.
+        Entry& insert(context::Context& ctx, value::Value key, bool& inserted);
+        bool erase(context::Context& ctx, value::Value& key);
+
+        // Deleting an entry moves the last one into its place.
+        std::vector<Entry>& entries();
+
+        // A table with the same layout whose keys and values went through
+        // `copy`, for sending to another isolate.
+        HashTable transfer(const value::CopyValue& copy) const;
+    };
+
+    class Map : public value::Native {
+    public:
+        static constexpr std::string_view NAME = "map";
+
+        HashTable table;
+
+        std::string_view type_name() const override;
+        std::string_view vtable_name() const override;
+        std::shared_ptr<value::Native> transfer(const std::shared_ptr<value::Native>& self, const value::CopyValue& copy) const override;
+    };
+
+    class Set : public value::Native {
+    public:
+        static constexpr std::string_view NAME = "set";
+
+        HashTable table;
+
+        std::string_view type_name() const override;
+        std::string_view vtable_name() const override;
+        std::shared_ptr<value::Native> transfer(const std::shared_ptr<value::Native>& self, const value::CopyValue& copy) const override;
+    };
+
+    value::Value map_prototype();
+    value::Value set_prototype();
+
+    // map() makes an empty map, map(pairs) one from an array of [key, value]
+    // arrays. set() and set(array) work the same way.
+    value::Value make_map(context::Context& ctx, std::vector<value::Value> args);
+    value::Value make_set(context::Context& ctx, std::vector<value::Value> args);
+}
@@ -12,6 +12,10 @@
 #include <exec/value.hpp>
 #include <exec/error.hpp>
 
+namespace ejdi::exec::isolate {
+    class Shared;
+}
+
 namespace ejdi::exec::context {
     struct GlobalContext;
 
@@ -29,15 +33,30 @@ namespace ejdi::exec::context {
 
     struct GlobalContext {
         std::shared_ptr<value::Object> core;
+        std::shared_ptr<isolate::Shared> shared;
 
         std::unordered_map<std::string, std::shared_ptr<value::Object>> modules;
-        std::unordered_map<std::string, linemap::Linemap> linemaps;
         std::vector<std::filesystem::path> global_import_paths;
 
-        static GlobalContext with_core();
+        // Set for isolates: output is held back until a whole line is
+        // available, so concurrently running isolates never interleave.
+        bool line_serialized_output = false;
+        std::string pending_output;
+
+        // The to_s methods the core prototypes start out with. format::Writer
+        // formats values directly only while their to_s is still one of these.
+        std::vector<std::shared_ptr<value::Function>> builtin_to_s;
+
+        static GlobalContext with_core(std::shared_ptr<isolate::Shared> shared = nullptr);
 
         value::Value load_module(std::string_view module, Context* loading_from = nullptr);
-        void print_error_message(const error::RuntimeError& error) const;
+        void print_error_message(const error::RuntimeError& error);
+
+        void write(std::string_view str);
+        // Also writes out a partial line an isolate is holding back.
+        void flush();
+        // Writes out a partial line an isolate is still holding back.
+        void close_output();
 
         std::shared_ptr<value::Object> new_module(std::string name);
     };
@@ -8,4 +8,10 @@ namespace ejdi::exec {
     void exec_program(context::Context& ctx, const ast::Program& prog);
     void exec(context::Context& ctx, const ast::Stmt& stmt);
     value::Value eval(context::Context& ctx, const ast::Expr& expr);
+
+    // The ordering behind the comparison operators: negative, zero or
+    // positive. Both values must have the same type, and functions, objects
+    // and arrays only compare equal or unequal. == and != don't go through
+    // here: for them values of different types are simply unequal.
+    int compare(value::Value& left, value::Value& right);
 }
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include <exec/value.hpp>
+#include <exec/context.hpp>
+
+namespace ejdi::exec::format {
+    // The shortest decimal that reads back as the same float, without an
+    // exponent unless the number is very close to zero. Infinities are inf
+    // and -inf, and every NaN is nan.
+    void number(std::string& out, float x);
+    std::string number(float x);
+
+    // Builds the text of to_s. Numbers, strings, booleans, () and arrays are
+    // formatted here directly unless a script replaced their prototype's
+    // to_s; everything else goes through its to_s method.
+    // With a sink the text is handed to it in chunks as it grows, so
+    // printing a large array never holds all of its text at once.
+    class Writer {
+        std::string text_;
+        context::GlobalContext* sink;
+
+        void spill();
+
+    public:
+        explicit Writer(context::GlobalContext* sink = nullptr) : sink(sink) {}
+
+        void write(std::string_view str);
+        void value(context::Context& ctx, value::Value& val);
+        // Passes the rest on to the sink.
+        void finish();
+
+        std::string& text() {
+            return text_;
+        }
+    };
+
+    std::string to_s(context::Context& ctx, value::Value& val);
+}
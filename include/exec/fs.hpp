@@ -0,0 +1,95 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <exec/value.hpp>
+#include <exec/context.hpp>
+#include <exec/output.hpp>
+
+namespace ejdi::exec::fs {
+    // An open file descriptor. Reads go through one large buffer that is
+    // reused for the life of the file, so reading lines only allocates the
+    // line strings; writes go through an output::Sink. Every operation takes
+    // the file's lock, since standard input is one File shared by all
+    // isolates.
+    class File : public value::Native {
+        mutable std::mutex mutex;
+        int fd;
+        bool owned;
+        bool readable;
+        bool at_eof = false;
+
+        std::vector<char> buffer;
+        std::size_t start = 0;
+        std::size_t end = 0;
+
+        std::unique_ptr<output::Sink> sink;
+
+        // These expect the caller to hold the lock.
+        void check_open(context::Context& ctx) const;
+        bool fill(context::Context& ctx);
+        // Flushes and closes the descriptor; returns the errno of the first
+        // write or close that failed, or 0.
+        int release();
+        void check_written(context::Context& ctx);
+
+    public:
+        static constexpr std::string_view NAME = "file";
+        static constexpr std::size_t BUFFER_SIZE = 1 << 20;
+
+        // `owned` files are closed when they are destroyed.
+        File(int fd, bool owned, bool readable, bool writable);
+        ~File();
+
+        bool is_open() const;
+        // Write errors that haven't been reported yet are raised.
+        void close(context::Context& ctx);
+
+        // Up to `size` bytes, less only at the end of the file.
+        std::string read(context::Context& ctx, std::size_t size);
+        std::string read_all(context::Context& ctx);
+        // The next line without its "\n" or "\r\n", nullopt at the end.
+        std::optional<std::string> read_line(context::Context& ctx);
+
+        void write(context::Context& ctx, std::string_view str);
+        void flush(context::Context& ctx);
+
+        std::string_view type_name() const override;
+        std::string_view vtable_name() const override;
+    };
+
+    // A file mapped read-only into memory, unmapped when the last reference
+    // goes away. Its methods mirror String's and work on the mapped bytes;
+    // only the pieces they return are copied.
+    class Mapping : public value::Native {
+        const char* data = nullptr;
+        std::size_t size = 0;
+
+    public:
+        static constexpr std::string_view NAME = "mapping";
+
+        Mapping(context::Context& ctx, const std::string& path);
+        ~Mapping();
+
+        Mapping(const Mapping&) = delete;
+        Mapping& operator=(const Mapping&) = delete;
+
+        std::string_view view() const {
+            return { data, size };
+        }
+
+        std::string_view type_name() const override;
+        std::string_view vtable_name() const override;
+    };
+
+    value::Value file_prototype();
+    value::Value mapping_prototype();
+
+    // The exports of require("fs"): open(path[, mode]), read_all(path),
+    // write_all(path, str), map(path) and stdin. Output goes through print().
+    value::Value module(context::GlobalContext& global);
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <filesystem>
+
+#include <linemap.hpp>
+#include <ast.hpp>
+#include <exec/value.hpp>
+#include <exec/output.hpp>
+
+namespace ejdi::exec::context {
+    struct Context;
+}
+
+namespace ejdi::exec::channel {
+    class Channel;
+}
+
+namespace ejdi::exec::scheduler {
+    class Scheduler;
+}
+
+namespace ejdi::exec::fs {
+    class File;
+}
+
+namespace ejdi::exec::isolate {
+    // A parsed module. Sources are immutable once published, so every
+    // isolate in the process can execute the same AST.
+    struct Source {
+        std::string text;
+        linemap::Linemap linemap;
+        /*nullable*/ std::shared_ptr<const ast::Program> program;
+
+        Source(std::string text)
+            : text(std::move(text))
+            , linemap(this->text) {}
+    };
+
+    // State shared by all isolates of a process. Everything in here is
+    // either immutable or guarded by its own lock; the heaps (core, modules)
+    // stay in the individual GlobalContexts.
+    class Shared {
+    public:
+        // declared first so they're flushed after the worker threads stop
+        output::Sink out { 1 };
+        output::Sink err { 2 };
+        // standard input, read by readline() and fs.stdin in every isolate,
+        // so no isolate's read-ahead is lost to another
+        std::shared_ptr<fs::File> in;
+
+    private:
+        mutable std::mutex sources_mutex;
+        std::unordered_map<std::string, std::shared_ptr<const Source>> sources;
+
+        std::mutex channels_mutex;
+        std::unordered_map<std::string, std::shared_ptr<channel::Channel>> channels;
+
+        std::mutex scheduler_mutex;
+        std::unique_ptr<scheduler::Scheduler> scheduler_;
+
+    public:
+        // threads in the spawn() pool; 0 means one per hardware thread
+        std::size_t worker_count = 0;
+
+        Shared();
+        ~Shared();
+
+        // Reads and parses the file on first use. A source that failed to
+        // parse is still published (without a program) so errors can be
+        // reported against it.
+        std::shared_ptr<const Source> load_source(const std::filesystem::path& path);
+        /*nullable*/ std::shared_ptr<const Source> find_source(const std::string& path) const;
+
+        // Returns the channel registered under `name`, creating it with the
+        // given capacity if this is the first isolate to ask for it.
+        std::shared_ptr<channel::Channel> named_channel(const std::string& name, std::size_t capacity);
+
+        // The pool behind spawn(), started on first use.
+        scheduler::Scheduler& scheduler();
+    };
+
+
+    // A value detached from the heap it was created in. Nothing in the graph
+    // is referenced by the sending isolate, so it can be handed to another
+    // thread and attached to that thread's heap.
+    struct Message {
+        value::Value value;
+        // objects whose prototype was the sender's core Object; attach()
+        // points them at the receiver's one
+        std::vector<std::shared_ptr<value::Object>> relink;
+    };
+
+    // Deep-copies `value` out of the current isolate. Frozen objects and
+    // arrays are shared as they are; uniquely owned strings and arrays of
+    // plain numbers/booleans are moved or copied in bulk instead of element
+    // by element.
+    Message detach(context::Context& ctx, value::Value value);
+    value::Value attach(context::Context& ctx, Message message);
+
+    // Runs `module` in `count` independent isolates, one thread each, and
+    // returns the number of isolates that ended with an error.
+    std::size_t run(std::shared_ptr<Shared> shared, std::string module, std::size_t count);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <functional>
+#include <optional>
+
+#include <exec/value.hpp>
+
+namespace ejdi::exec::iterator {
+    // An iterator implemented in C++. `next` produces elements until it
+    // returns nullopt; the methods live in the core Iterator object, next to
+    // Iterator.end.
+    class NativeIterator : public value::Native {
+    public:
+        static constexpr std::string_view NAME = "iterator";
+
+        std::function<std::optional<value::Value>(context::Context&)> next;
+
+        template< typename F >
+        NativeIterator(F next) : next(std::move(next)) {}
+
+        std::string_view type_name() const override;
+        std::string_view vtable_name() const override;
+    };
+
+    template< typename F >
+    value::Value make(F next) {
+        return std::make_shared<NativeIterator>(std::move(next));
+    }
+
+    // range(stop), range(start, stop) or range(start, stop, step). `for`
+    // runs over a range as a counted loop, without calling any methods.
+    class Range : public value::Native {
+    public:
+        static constexpr std::string_view NAME = "range";
+
+        float start;
+        float stop;
+        float step;
+        std::size_t count;
+
+        // range() checks the arguments and computes `count`
+        Range(float start, float stop, float step, std::size_t count);
+
+        float at(std::size_t i) const;
+
+        std::string_view type_name() const override;
+        std::string_view vtable_name() const override;
+        std::shared_ptr<value::Native> transfer(const std::shared_ptr<value::Native>& self, const value::CopyValue&) const override;
+        bool shareable() const override;
+    };
+
+    // Anything `for` can loop over, as a native iterator. Objects following
+    // the __iter/__next protocol are wrapped.
+    std::shared_ptr<NativeIterator> from(context::Context& ctx, value::Value iterable);
+
+    // The Iterator prototype also has lazy adapters (map, filter, take,
+    // skip, zip, enumerate, chunk), which wrap the source iterator and pull
+    // one element at a time through the whole pipeline, and collect().
+    value::Value prototype();
+    value::Value range_prototype();
+    value::Value range(context::Context& ctx, std::vector<value::Value> args);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <exec/value.hpp>
+#include <exec/context.hpp>
+
+namespace ejdi::exec::json {
+    // Parsing runs in two stages, like simdjson: the first classifies 64
+    // bytes at a time into bit masks (quotes, backslashes, brackets and
+    // punctuation, whitespace) and turns them into the positions of every
+    // token outside of strings; the second walks those positions and builds
+    // the values. Objects get the core Object prototype, null becomes ().
+    //
+    // Object keys become field names without being interned, so keys that
+    // are data (ids, timestamps, ...) are freed with their objects instead
+    // of filling the process-wide symbol table.
+    value::Value parse(context::Context& ctx, std::string_view text);
+
+    // Writes the value into one growing string. Fields holding functions
+    // are left out (and are null in arrays); other native values, NaN and
+    // infinities can't be written.
+    std::string stringify(context::Context& ctx, value::Value& val);
+
+    // The `json` object of the prelude: parse(text), stringify(value) and
+    // lines(iterable), which lazily parses one document per non-empty line
+    // of a file, a mapping's lines() or any other iterable of strings.
+    // The prelude is built before its global context, so this takes the
+    // core object.
+    value::Value module(const std::shared_ptr<value::Object>& core);
+}
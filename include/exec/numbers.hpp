@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+
+#include <exec/value.hpp>
+
+namespace ejdi::exec::numbers {
+    // A packed array of numbers: 4 bytes per element instead of a whole
+    // Value, and the whole-array operations below run on SIMD kernels.
+    class NumberArray : public value::Native {
+    public:
+        static constexpr std::string_view NAME = "number array";
+
+        std::vector<float> data;
+
+        NumberArray() = default;
+        NumberArray(std::vector<float> data) : data(std::move(data)) {}
+
+        std::string_view type_name() const override;
+        std::string_view vtable_name() const override;
+        std::shared_ptr<value::Native> transfer(const std::shared_ptr<value::Native>& self, const value::CopyValue&) const override;
+    };
+
+    float sum(const float* data, std::size_t size);
+    float min(const float* data, std::size_t size);
+    float max(const float* data, std::size_t size);
+    float dot(const float* a, const float* b, std::size_t size);
+
+    void add(const float* a, const float* b, float* out, std::size_t size);
+    void mul(const float* a, const float* b, float* out, std::size_t size);
+    void scale(const float* a, float factor, float* out, std::size_t size);
+    void fill(float* out, float value, std::size_t size);
+
+    value::Value prototype();
+    // numbers(n) makes n zeros, numbers(array) packs an array of numbers.
+    value::Value make(context::Context& ctx, value::Value from);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace ejdi::exec::output {
+    // Buffered writes to a file descriptor, shared by all isolates. Text is
+    // held back until the buffer fills up, a line ends and the descriptor
+    // is a terminal, flush() is called, or the sink is destroyed at exit.
+    // The buffer and a write larger than it go out in one writev. Output
+    // that can't be written is dropped; the error is kept for take_error().
+    class Sink {
+    public:
+        static constexpr std::size_t CAPACITY = 1 << 16;
+
+        struct Stats {
+            std::uint64_t bytes = 0;
+            std::uint64_t syscalls = 0;
+        };
+
+    private:
+        int fd;
+        bool tty;
+
+        std::mutex mutex;
+        std::string buffer;
+        Stats stats_;
+        int error = 0;
+
+        void write_out(std::string_view extra);
+
+    public:
+        explicit Sink(int fd);
+        ~Sink();
+
+        Sink(const Sink&) = delete;
+        Sink& operator=(const Sink&) = delete;
+
+        void write(std::string_view str);
+        void flush();
+        Stats stats();
+        // The errno of the first failed write since the last call, or 0.
+        int take_error();
+    };
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <memory>
+
+#include <exec/value.hpp>
+#include <exec/context.hpp>
+
+namespace ejdi::exec::parallel {
+    // Whether calling `func` on a worker isolate behaves the same as calling
+    // it here. Workers only share the prelude, so the function may read its
+    // arguments, its own locals and side-effect free prelude names, may only
+    // assign to its own locals, and may only modify values it created itself:
+    // arguments and anything reached through them are read-only.
+    bool is_parallel_safe(context::Context& ctx, const value::Function& func);
+
+    // Split `arr` into chunks that run on the spawn() pool and put the
+    // results back in order. Small arrays and functions that aren't
+    // parallel-safe run sequentially on the calling thread. Results of a
+    // parallel-safe function are copies on either path; par_filter returns
+    // the elements themselves.
+    value::Value par_map(context::Context& ctx, std::shared_ptr<value::Array> arr, std::shared_ptr<value::Function> func);
+    value::Value par_filter(context::Context& ctx, std::shared_ptr<value::Array> arr, std::shared_ptr<value::Function> func);
+    // `func` must be associative: chunks are reduced separately and their
+    // results are then folded into `init` in order. Only runs on the pool
+    // when `init` and the elements all have the same type.
+    value::Value par_reduce(context::Context& ctx, std::shared_ptr<value::Array> arr, std::shared_ptr<value::Function> func, value::Value init);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <exec/value.hpp>
+
+namespace ejdi::exec::regex {
+    // Byte-oriented regular expressions: literals, `.`, classes like [a-z]
+    // and [^0-9], \d \w \s and their negations, groups, (?:...),
+    // alternation, * + ? {n} {n,} {n,m} (lazy with a trailing ?), ^ and $.
+    //
+    // Patterns compile to a Thompson NFA. Whether a string matches is
+    // decided by a DFA built lazily from it, one state per set of NFA states
+    // actually reached; match positions and groups come from a Pike VM.
+    // is_match and a single search run in time linear in the input. A
+    // search can't stop at a match while a higher-priority thread is still
+    // alive, though, so iterating over all matches is quadratic in the worst
+    // case: `a.*b|a` on a long run of `a` scans to the end once per match.
+    class Regex : public value::Native {
+    public:
+        static constexpr std::string_view NAME = "regex";
+
+        enum class Op : std::uint8_t { Byte, Split, Jump, Save, Begin, End, Match };
+
+        // Byte: x is the index of the byte set. Split: try x first, then y.
+        // Jump: go to x. Save: store the position in capture slot x.
+        struct Inst {
+            Op op;
+            std::uint32_t x = 0;
+            std::uint32_t y = 0;
+        };
+
+        using ByteSet = std::array<std::uint64_t, 4>;
+
+        std::string pattern;
+        std::vector<Inst> program;
+        std::vector<ByteSet> sets;
+        // including group 0, the whole match
+        std::size_t groups = 1;
+
+    private:
+        struct DfaState {
+            std::vector<std::uint32_t> pcs;
+            bool match;
+            std::int8_t match_at_end = -1;
+        };
+
+        std::vector<DfaState> dfa_states;
+        // 256 transitions per state, -1 until computed
+        std::vector<std::int32_t> dfa_next;
+        std::map<std::vector<std::uint32_t>, std::int32_t> dfa_ids;
+        std::int32_t dfa_start = -1;
+
+        std::vector<std::uint32_t> closure(std::vector<std::uint32_t> pcs, bool begin, bool end) const;
+        std::int32_t dfa_state(std::vector<std::uint32_t> pcs);
+        std::int32_t dfa_step(std::int32_t state, unsigned char byte);
+
+    public:
+        static bool contains(const ByteSet& set, unsigned char byte) {
+            return (set[byte >> 6] >> (byte & 63)) & 1;
+        }
+
+        bool is_match(std::string_view str);
+        // Calls on_match for each leftmost-first, non-overlapping match until
+        // it returns false. Each match is a new search from the end of the
+        // previous one (see above for the worst case). It gets the start and
+        // end offsets of the match and of every group, npos for groups that
+        // didn't participate.
+        void for_each_match(std::string_view str, const std::function<bool(const std::vector<std::size_t>&)>& on_match);
+
+        std::string_view type_name() const override;
+        std::string_view vtable_name() const override;
+        std::shared_ptr<value::Native> transfer(const std::shared_ptr<value::Native>& self, const value::CopyValue&) const override;
+    };
+
+    // Compiled regexes are cached per thread by pattern, so calling
+    // regex("...") in a loop compiles the pattern once.
+    std::shared_ptr<Regex> compile(context::Context& ctx, const std::string& pattern);
+
+    value::Value prototype();
+}
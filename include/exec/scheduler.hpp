@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <optional>
+#include <thread>
+#include <filesystem>
+
+#include <exec/value.hpp>
+#include <exec/error.hpp>
+#include <exec/isolate.hpp>
+
+namespace ejdi::exec::context {
+    struct GlobalContext;
+}
+
+namespace ejdi::exec::scheduler {
+    // The result of a spawned task. Completed once, by whichever thread ran
+    // the task; futures themselves can be passed between isolates.
+    class Future : public value::Native {
+        mutable std::mutex mutex;
+        std::condition_variable completed;
+        std::atomic<bool> done { false };
+
+        std::optional<isolate::Message> result;
+        std::optional<error::RuntimeError> error;
+
+    public:
+        static constexpr std::string_view NAME = "future";
+
+        std::string_view type_name() const override;
+        std::string_view vtable_name() const override;
+        std::shared_ptr<value::Native> transfer(const std::shared_ptr<value::Native>& self, const value::CopyValue&) const override;
+        bool shareable() const override;
+
+        void resolve(isolate::Message message);
+        void fail(error::RuntimeError error);
+
+        bool is_done() const;
+        void wait_for(std::chrono::milliseconds timeout);
+
+        // Attaches the result to the awaiting isolate, or rethrows the
+        // task's error. Only valid once is_done() is true.
+        value::Value take(context::Context& ctx);
+    };
+
+    struct Task {
+        std::shared_ptr<value::Function> func;
+        isolate::Message args;
+        std::filesystem::path module_path;
+        std::shared_ptr<Future> future;
+    };
+
+    // A work-stealing pool of isolates. Every worker owns a GlobalContext and
+    // a deque: it pushes and pops its own tasks at the back and steals from
+    // the front of the others when it runs dry.
+    class Scheduler {
+        struct Worker {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+            std::thread thread;
+        };
+
+        isolate::Shared& shared;
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::atomic<std::size_t> next_worker { 0 };
+        std::atomic<std::size_t> queued { 0 };
+        std::atomic<bool> stopping { false };
+
+        std::mutex idle_mutex;
+        std::condition_variable idle;
+
+        std::optional<Task> take(std::optional<std::size_t> own);
+        void work(std::size_t index);
+        static void run(context::GlobalContext& global, Task task);
+
+    public:
+        Scheduler(isolate::Shared& shared, std::size_t threads);
+        ~Scheduler();
+
+        std::size_t size() const;
+
+        void submit(Task task);
+        // Runs queued tasks on the calling thread, in its own isolate, until
+        // `future` is completed.
+        void wait(context::GlobalContext& global, Future& future);
+    };
+
+    value::Value prototype();
+
+    value::Value spawn(context::Context& ctx, std::vector<value::Value> args);
+    value::Value await(context::Context& ctx, std::shared_ptr<Future> future);
+    value::Value join_all(context::Context& ctx, std::shared_ptr<value::Array> futures);
+}
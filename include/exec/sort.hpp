@@ -0,0 +1,15 @@
+#pragma once
+
+#include <memory>
+
+#include <exec/value.hpp>
+#include <exec/context.hpp>
+
+namespace ejdi::exec::sort {
+    // Stable in-place sort. Without `cmp` the elements must all be numbers,
+    // all strings or all booleans and are ordered like the `<` operator;
+    // `cmp(a, b)` returns a negative number when `a` goes first.
+    void sort(context::Context& ctx, std::shared_ptr<value::Array> arr, std::shared_ptr<value::Function> cmp = nullptr);
+    // Stable in-place sort by `key(elem)`, which is called once per element.
+    void sort_by(context::Context& ctx, std::shared_ptr<value::Array> arr, std::shared_ptr<value::Function> key);
+}
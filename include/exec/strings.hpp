@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include <exec/value.hpp>
+
+namespace ejdi::exec::strings {
+    // Position of the first `needle` at or after `from`, or npos. Single
+    // bytes are searched with memchr, longer needles by comparing their
+    // first and last byte 16 positions at a time and checking the rest only
+    // where both match.
+    std::size_t find(std::string_view str, std::string_view needle, std::size_t from = 0);
+    std::size_t rfind(std::string_view str, std::string_view needle);
+
+    // The separators must not be empty.
+    value::Array split(std::string_view str, std::string_view sep);
+    std::string replace(std::string_view str, std::string_view from, std::string_view to);
+
+    // Splits on "\n" or "\r\n"; a trailing newline doesn't start a new line.
+    value::Array lines(std::string_view str);
+    std::string_view trim(std::string_view str);
+    // ASCII only, other bytes are kept as they are.
+    std::string upper(std::string_view str);
+    std::string lower(std::string_view str);
+}
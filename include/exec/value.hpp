@@ -1,14 +1,18 @@
 #pragma once
 
 #include <cassert>
+#include <cstdint>
 #include <functional>
+#include <type_traits>
 #include <unordered_map>
 #include <variant>
 #include <string>
 #include <vector>
 #include <memory>
+#include <optional>
 
 #include <ast.hpp>
+#include <symbol.hpp>
 #include <exec/error.hpp>
 
 namespace ejdi::exec::context {
@@ -21,7 +25,8 @@ namespace ejdi::exec::value {
     struct Value;
     class Object;
     class Function;
-    using Array = std::vector<Value>;
+    class Native;
+    struct Array;
 
     using ValueVariant = std::variant<
         Unit,
@@ -30,13 +35,51 @@ namespace ejdi::exec::value {
         std::shared_ptr<std::string>,
         std::shared_ptr<Function>,
         std::shared_ptr<Object>,
-        std::shared_ptr<Array>
+        std::shared_ptr<Array>,
+        std::shared_ptr<Native>
         >;
 
+    // Deep-copies a value out of the current isolate, see isolate::detach.
+    using CopyValue = std::function<Value(Value&)>;
+
+    // Base for types implemented in C++ (channels, ...). Subclasses provide
+    // a static NAME and are looked up with is<T>()/as<T>() like any other
+    // type; their methods live in the core object named by vtable_name().
+    class Native {
+    public:
+        static constexpr std::string_view NAME = "native";
+
+        virtual ~Native() = default;
+
+        virtual std::string_view type_name() const = 0;
+        virtual std::string_view vtable_name() const = 0;
+
+        // Returns something that can be handed to another isolate: the
+        // object itself if it is thread-safe, otherwise a copy, whose
+        // nested values go through `copy`.
+        // nullptr if the value can't leave its isolate.
+        virtual std::shared_ptr<Native> transfer(const std::shared_ptr<Native>&, const CopyValue&) const {
+            return nullptr;
+        }
+
+        // Whether the object itself can be used from several isolates at
+        // once. Only such natives can be part of a frozen graph.
+        virtual bool shareable() const {
+            return false;
+        }
+    };
+
     template< typename T >
+    constexpr bool is_native = std::is_base_of_v<Native, T>;
+
+    template< typename T, typename = void >
     struct _WrappedRc {
         using TYPE = T;
     };
+    template< typename T >
+    struct _WrappedRc<T, std::enable_if_t<is_native<T>>> {
+        using TYPE = std::shared_ptr<T>;
+    };
     template<>
     struct _WrappedRc<std::string> {
         using TYPE = std::shared_ptr<std::string>;
@@ -89,6 +132,13 @@ namespace ejdi::exec::value {
     inline std::string_view __type_name(std::shared_ptr<Array>*) {
         return "array";
     }
+    inline std::string_view __type_name(std::shared_ptr<Native>* native) {
+        return (*native)->type_name();
+    }
+    template< typename T >
+    std::enable_if_t<is_native<T>, std::string_view> __type_name(T*) {
+        return T::NAME;
+    }
     template< typename T >
     inline std::string_view type_name() {
         return __type_name(static_cast<T*>(nullptr));
@@ -99,7 +149,12 @@ namespace ejdi::exec::value {
 
     template< typename T >
     bool __is_impl(ValueVariant& value) {
-        return std::holds_alternative<WrappedRc<T>>(value);
+        if constexpr (is_native<T>) {
+            auto native = std::get_if<std::shared_ptr<Native>>(&value);
+            return native != nullptr && dynamic_cast<T*>(native->get()) != nullptr;
+        } else {
+            return std::holds_alternative<WrappedRc<T>>(value);
+        }
     }
     template<>
     inline bool __is_impl<Value>(ValueVariant&) {
@@ -107,9 +162,13 @@ namespace ejdi::exec::value {
     }
 
     template< typename T >
-    auto& __as_impl(ValueVariant& value, Value&) {
+    decltype(auto) __as_impl(ValueVariant& value, Value&) {
         if (__is_impl<T>(value)) {
-            return std::get<WrappedRc<T>>(value);
+            if constexpr (is_native<T> && !std::is_same_v<T, Native>) {
+                return std::static_pointer_cast<T>(std::get<std::shared_ptr<Native>>(value));
+            } else {
+                return std::get<WrappedRc<T>>(value);
+            }
         } else {
             std::string msg = "wrong type: expected ";
             msg += type_name<T>();
@@ -120,8 +179,8 @@ namespace ejdi::exec::value {
     }
 
     template<>
-    inline auto& __as_impl<Value>(ValueVariant&, Value& val) {
-        return val;
+    inline decltype(auto) __as_impl<Value>(ValueVariant&, Value& val) {
+        return (val);
     }
 
     struct Value {
@@ -141,7 +200,9 @@ namespace ejdi::exec::value {
         Value(std::shared_ptr<Function> val) : value(std::move(val)) {}
         Value(std::shared_ptr<Object> val) : value(std::move(val)) {}
         Value(std::shared_ptr<Array> val) : value(std::move(val)) {}
-        Value(Array val) : value(std::make_shared<Array>(std::move(val))) {}
+        Value(Array val);
+        template< typename T, typename = std::enable_if_t<is_native<T>> >
+        Value(std::shared_ptr<T> val) : value(std::shared_ptr<Native>(std::move(val))) {}
 
         template< typename T >
         bool is() {
@@ -155,24 +216,137 @@ namespace ejdi::exec::value {
 
     };
 
+    // Arrays are plain vectors of values, plus the flag set by freeze().
+    // Copies always start out mutable.
+    struct Array : std::vector<Value> {
+        bool frozen = false;
+
+        using std::vector<Value>::vector;
+        Array(const Array& other) : std::vector<Value>(other) {}
+        Array(Array&& other) = default;
+        Array& operator=(const Array& other) = default;
+        Array& operator=(Array&& other) = default;
+
+        void ensure_mutable() const;
+    };
+
+    inline Value::Value(Array val) : value(std::make_shared<Array>(std::move(val))) {}
+
+    // Field storage, in insertion order. Most objects have a handful of
+    // fields, which are found by a linear scan over a flat array of symbols;
+    // past INDEX_ABOVE fields an open-addressing index of positions is kept
+    // too.
+    //
+    // Names that come from data (JSON keys, ...) don't have to be interned:
+    // the symbol table is never freed, so a field whose name the program
+    // never mentions keeps its name as a string, which goes away with the
+    // object. Lookups by symbol still find such a field if the name is
+    // interned later.
+    class Fields {
+    public:
+        static constexpr std::size_t INDEX_ABOVE = 8;
+        // stands in for the symbol of a field added by a name that isn't
+        // interned
+        static constexpr symbol::Symbol UNINTERNED = symbol::Symbol(UINT32_MAX);
+
+    private:
+        std::vector<symbol::Symbol> names;
+        std::vector<Value> values;
+        // position + 1 of each field, 0 for empty slots
+        std::vector<std::uint32_t> index;
+        // empty until a field is UNINTERNED, then the name of every such
+        // field by position
+        std::vector<std::string> spelled;
+
+        std::size_t hash_position(std::size_t position) const;
+        void add_to_index(std::size_t position);
+        void rebuild_index(std::size_t size);
+        void append(symbol::Symbol name, Value value);
+
+    public:
+        void reserve(std::size_t size);
+        // Removes every field but keeps the storage.
+        void clear();
+
+        /*nullable*/ Value* find(symbol::Symbol name);
+        /*nullable*/ Value* find(std::string_view name);
+        // Only looks at UNINTERNED fields.
+        /*nullable*/ Value* find_uninterned(std::string_view name);
+        void insert_or_assign(symbol::Symbol name, Value value);
+        // Uses the name's symbol if it has one and doesn't intern it
+        // otherwise.
+        void insert_or_assign(std::string_view name, Value value);
+
+        std::size_t size() const { return names.size(); }
+        // UNINTERNED for a field added by a name that isn't interned;
+        // name_string() works for either
+        symbol::Symbol name(std::size_t i) const { return names[i]; }
+        const std::string& name_string(std::size_t i) const;
+        Value& value(std::size_t i) { return values[i]; }
+    };
+
+    // The string overloads of set() intern the name; lookups give up early
+    // if it was never interned and no field was added without interning it.
     struct Object {
-        std::unordered_map<std::string, Value> map;
+        Fields fields;
         /*nullable*/ std::shared_ptr<Object> prototype;
         bool mutable_prototype_fields = false;
+        // Set by freeze(): the fields can't change any more, so the object
+        // can be read from any isolate without synchronization.
+        bool frozen = false;
+        // Set by freeze() in place of a link to a built-in prototype, which
+        // stays mutable: lookups that get past the object's own prototype
+        // chain continue in the reading isolate's core object of this name.
+        std::optional<symbol::Symbol> core_prototype;
 
         Object(std::shared_ptr<Object> prototype = nullptr);
         static std::shared_ptr<Object> scope(std::shared_ptr<Object> parent = nullptr);
 
+        Value& get(symbol::Symbol name);
         Value& get(const std::string& name);
+        Function& getf(symbol::Symbol name);
         Function& getf(const std::string& name);
+        /*nullable*/ Value* try_get(symbol::Symbol name);
         /*nullable*/ Value* try_get(const std::string& name);
+        /*nullable*/ Value* try_get_no_prototype(symbol::Symbol name);
         /*nullable*/ Value* try_get_no_prototype(const std::string& name);
-        void set(std::string name, Value value);
-        void set_no_prototype(std::string name, Value value);
+        void set(symbol::Symbol name, Value value);
+        void set(const std::string& name, Value value);
+        void set_no_prototype(symbol::Symbol name, Value value);
+        void set_no_prototype(const std::string& name, Value value);
     };
 
 
     Object& get_vtable(context::Context& ctx, Value& val);
+    // get_vtable(ctx, val).get(name), which also follows the core_prototype
+    // of frozen objects. lookupf returns its own reference to the function,
+    // so calling it stays safe if the call reassigns the field.
+    Value& lookup(context::Context& ctx, Value& val, symbol::Symbol name);
+    std::shared_ptr<Function> lookupf(context::Context& ctx, Value& val, symbol::Symbol name);
+
+    // Shared one-character strings, so walking a string doesn't allocate
+    // once per character. The cache keeps a reference, so `~` never
+    // appends to them in place.
+    std::shared_ptr<std::string> char_string(char c);
+
+    // Converts a number used as an index, size or count, dropping the
+    // fraction. Anything outside [0, end), including NaN and infinities,
+    // raises `error` instead of overflowing the conversion.
+    std::size_t to_index(context::Context& ctx, float x, std::size_t end, const char* error);
+
+    // Converts a number of elements that a script asks for up front
+    // (reserve(n), numbers(n)), each taking `element_size` bytes. Sizes
+    // that can't fit in physical memory raise `error` instead of ending
+    // in std::bad_alloc.
+    std::size_t to_capacity(context::Context& ctx, float x, std::size_t element_size, const char* error);
+
+    // Recursively makes objects (with their non-core prototypes) and arrays
+    // immutable. Frozen graphs are shared between isolates by reference, so
+    // nothing in them may point into the freezing isolate's mutable state:
+    // links to built-in prototypes are replaced by core_prototype, and
+    // natives that aren't shareable() (maps, sets, number arrays, regexes,
+    // files, ...) are rejected with an error before anything is frozen.
+    void freeze(context::Context& ctx, Value& val);
 
 
     struct IFunction;
@@ -215,6 +389,8 @@ namespace ejdi::exec::value {
         }
 
         Value call(context::Context& ctx, std::vector<Value> args);
+
+        /*nullable*/ const LangFunction* lang_function() const;
     };
 
 
@@ -10,6 +10,7 @@
 #include <variant>
 
 #include <span.hpp>
+#include <symbol.hpp>
 
 namespace ejdi::lexer {
     struct LexemBase {
@@ -43,8 +44,14 @@ namespace ejdi::lexer {
     struct Word : LexemBase {
         static constexpr std::string_view NAME = "word";
 
-        Word(span::Span span, std::string str) : LexemBase(span, str) {}
-        Word(span::Span span, std::string_view str) : LexemBase(span, str) {}
+        symbol::Symbol symbol;
+
+        Word(span::Span span, std::string str)
+            : LexemBase(span, str)
+            , symbol(symbol::intern(this->str)) {}
+        Word(span::Span span, std::string_view str)
+            : LexemBase(span, str)
+            , symbol(symbol::intern(this->str)) {}
     };
 
 
@@ -77,10 +84,14 @@ namespace ejdi::lexer {
 
 
     struct NumberLit : LexemBase {
-        NumberLit(span::Span span, std::string_view str)
-            : LexemBase(span, std::string(str)) {}
+        NumberLit(span::Span span, std::string_view str);
+
+        float value() const {
+            return val;
+        }
 
-        float value() const;
+    private:
+        float val;
     };
 
 
@@ -104,8 +115,8 @@ namespace ejdi::lexer {
 
 
     namespace actions {
-        constexpr std::array<std::string_view, 25> punctuation {
-            ",", ".", ";",
+        constexpr std::array<std::string_view, 26> punctuation {
+            ",", ".", ";", ":",
                 "==", "!=", "<=", ">=", "+=", "-=", "*=", "/=", "%=", "~=",
                 "=", "<", ">", "+", "-", "*", "/", "%", "~",
                 "&&", "||", "!"
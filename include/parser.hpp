@@ -112,6 +112,8 @@ namespace ejdi::parser {
     PR(StringLiteral) parse_string_literal(ParseStream& in);
     PR(BoolLiteral) parse_bool_literal(ParseStream& in);
     PR(ArrayLiteral) parse_array_literal(ParseStream& in);
+    result::ParserResult<ast::ObjectField> parse_object_field(ParseStream& in);
+    PR(ObjectLiteral) parse_object_literal(ParseStream& in);
     PR(FunctionLiteral) parse_function_literal(ParseStream& in);
 
     template< typename T >
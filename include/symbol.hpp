@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace ejdi::symbol {
+    // An interned name. Every identifier is interned by the lexer, so field
+    // and variable lookups compare integers instead of hashing strings. The
+    // table is process-wide and shared by all isolates.
+    enum class Symbol : std::uint32_t {};
+
+    Symbol intern(std::string_view name);
+    // nullopt if `name` was never interned, in which case no object can have
+    // a field with that name.
+    std::optional<Symbol> find(std::string_view name);
+    const std::string& name(Symbol symbol);
+}
+
+// Interns a constant name once per call site.
+#define SYMBOL(name) ([]{ static const auto symbol = ::ejdi::symbol::intern(name); return symbol; }())
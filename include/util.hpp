@@ -1,8 +1,13 @@
 #pragma once
 
+#include <optional>
 #include <string_view>
 
 namespace ejdi::util {
     bool starts_with(std::string_view str, std::string_view pat);
     bool starts_with(std::string_view str, char pat);
+
+    // All of `str` as a decimal number, with an optional sign and exponent.
+    // Locale-independent, and never throws.
+    std::optional<float> parse_number(std::string_view str);
 }
@@ -348,6 +348,23 @@ Span ast::ArrayLiteral::span() const {
 }
 
 
+string ast::ObjectLiteral::debug(size_t depth) const {
+    string res = offset(depth) + "object";
+
+    for (const auto& field : fields->list) {
+        res += '\n';
+        res += offset(depth + 1) + field.name.str + ":\n";
+        res += ast_debug(field.value, depth + 2);
+    }
+
+    return res;
+}
+
+Span ast::ObjectLiteral::span() const {
+    return fields->span();
+}
+
+
 string ast::FunctionLiteral::debug(size_t depth) const {
     string res = offset(depth) + "func(";
 
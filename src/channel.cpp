@@ -0,0 +1,276 @@
+#include <thread>
+
+#include <exec/channel.hpp>
+#include <exec/context.hpp>
+
+using namespace std;
+using namespace ejdi::exec::value;
+using namespace ejdi::exec::context;
+using namespace ejdi::exec::isolate;
+
+using Ctx = Context&;
+
+namespace ejdi::exec::channel {
+    static constexpr size_t CLOSED = 1;
+    static constexpr size_t SENDER = 2;
+
+    // Spins for a short while, then yields the thread a few times. Returns
+    // false once the caller should park.
+    static bool backoff(size_t& attempt) {
+        attempt += 1;
+        if (attempt <= 64) {
+            return true;
+        } else if (attempt <= 80) {
+            this_thread::yield();
+            return true;
+        }
+        return false;
+    }
+
+    string_view Channel::type_name() const {
+        return NAME;
+    }
+
+    string_view Channel::vtable_name() const {
+        return "Channel";
+    }
+
+    shared_ptr<Native> Channel::transfer(const shared_ptr<Native>& self, const CopyValue&) const {
+        return self;
+    }
+
+    bool Channel::shareable() const {
+        return true;
+    }
+
+    size_t Channel::capacity() const {
+        return capacity_;
+    }
+
+    // The fences pair up with the one in park(): either the waiter sees the
+    // change that made it ready, or this sees the waiter and takes the
+    // mutex, which it holds until it is inside wait().
+    void Channel::wake(condition_variable& cv, atomic<size_t>& waiting, bool all) {
+        atomic_thread_fence(memory_order_seq_cst);
+        if (waiting.load(memory_order_relaxed) == 0) {
+            return;
+        }
+
+        { auto lock = lock_guard(mutex); }
+        if (all) {
+            cv.notify_all();
+        } else {
+            cv.notify_one();
+        }
+    }
+
+    template< typename Ready >
+    void Channel::park(condition_variable& cv, atomic<size_t>& waiting, Ready ready) {
+        auto lock = unique_lock(mutex);
+        waiting.fetch_add(1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (!ready()) {
+            cv.wait(lock);
+        }
+        waiting.fetch_sub(1, memory_order_relaxed);
+    }
+
+    // Never counts past the capacity, even for a moment, so a parked sender
+    // always sees the room a receive makes.
+    bool Channel::claim() {
+        auto count = held.load(memory_order_acquire);
+        while (count < capacity_) {
+            if (held.compare_exchange_weak(count, count + 1, memory_order_acq_rel)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool Channel::try_send(Message& message) {
+        auto before = state.fetch_add(SENDER, memory_order_acq_rel);
+        auto sent = false;
+        if ((before & CLOSED) == 0 && claim()) {
+            // a slow receive can still hold the cell for a moment
+            sent = queue.try_push(message);
+            if (!sent) {
+                held.fetch_sub(1, memory_order_acq_rel);
+                wake(writable, waiting_senders, false);
+            }
+        }
+        auto after = state.fetch_sub(SENDER, memory_order_acq_rel) - SENDER;
+
+        if (sent) {
+            wake(readable, waiting_receivers, false);
+        } else if (after == CLOSED) {
+            // the last send to finish lets receivers see the channel drained
+            wake(readable, waiting_receivers, true);
+        }
+        return sent;
+    }
+
+    bool Channel::send(Message message) {
+        size_t attempt = 0;
+        while (true) {
+            if (try_send(message)) {
+                return true;
+            } else if (is_closed()) {
+                return false;
+            } else if (!backoff(attempt)) {
+                park(writable, waiting_senders, [this]() {
+                    return held.load(memory_order_acquire) < capacity_ || is_closed();
+                });
+            }
+        }
+    }
+
+    optional<Message> Channel::try_recv() {
+        auto message = queue.try_pop();
+        if (message.has_value()) {
+            held.fetch_sub(1, memory_order_acq_rel);
+            wake(writable, waiting_senders, false);
+        }
+        return message;
+    }
+
+    optional<Message> Channel::recv() {
+        size_t attempt = 0;
+        while (true) {
+            auto message = try_recv();
+            if (message.has_value()) {
+                return message;
+            }
+
+            if (state.load(memory_order_acquire) == CLOSED) {
+                // no send is under way any more, so this one is final
+                return try_recv();
+            }
+
+            if (!backoff(attempt)) {
+                park(readable, waiting_receivers, [this]() {
+                    return !queue.empty() || state.load(memory_order_acquire) == CLOSED;
+                });
+            }
+        }
+    }
+
+    void Channel::close() {
+        state.fetch_or(CLOSED, memory_order_acq_rel);
+        wake(readable, waiting_receivers, true);
+        wake(writable, waiting_senders, true);
+    }
+
+    bool Channel::is_closed() const {
+        return (state.load(memory_order_acquire) & CLOSED) != 0;
+    }
+
+
+    static Value iterator_end(Ctx ctx) {
+        return ctx.global.core->get(SYMBOL("Iterator")).as<Object>()->get(SYMBOL("end"));
+    }
+
+    static Value empty(Ctx ctx) {
+        return ctx.global.core->get(SYMBOL("Channel")).as<Object>()->get(SYMBOL("empty"));
+    }
+
+    static Value receive(Ctx ctx, shared_ptr<Channel> chan) {
+        auto message = chan->recv();
+        if (message.has_value()) {
+            return attach(ctx, move(*message));
+        } else {
+            return iterator_end(ctx);
+        }
+    }
+
+    Value prototype() {
+        auto obj = make_shared<Object>();
+        // what try_recv returns when nothing is waiting; received values are
+        // copies, so they never are this object
+        obj->set("empty", make_shared<Object>());
+        obj->set("to_s",
+                 Function::native_expanded(
+                     [](Ctx) {
+                         return string("[channel]");
+                     })
+            );
+        obj->set("capacity",
+                 Function::native_expanded<Channel>(
+                     [](Ctx, auto chan) {
+                         return (float)chan->capacity();
+                     })
+            );
+        obj->set("send",
+                 Function::native_expanded<Channel, Value>(
+                     [](Ctx ctx, auto chan, Value val) {
+                         if (!chan->send(detach(ctx, move(val)))) {
+                             throw ctx.error("send on a closed channel");
+                         }
+
+                         return Unit{};
+                     })
+            );
+        obj->set("try_send",
+                 Function::native_expanded<Channel, Value>(
+                     [](Ctx ctx, auto chan, Value val) {
+                         if (chan->is_closed()) {
+                             throw ctx.error("send on a closed channel");
+                         }
+
+                         auto message = detach(ctx, move(val));
+                         if (chan->try_send(message)) {
+                             return true;
+                         } else if (chan->is_closed()) {
+                             throw ctx.error("send on a closed channel");
+                         }
+                         return false;
+                     })
+            );
+        obj->set("recv",
+                 Function::native_expanded<Channel>(
+                     [](Ctx ctx, auto chan) {
+                         return receive(ctx, move(chan));
+                     })
+            );
+        obj->set("try_recv",
+                 Function::native_expanded<Channel>(
+                     [](Ctx ctx, auto chan) -> Value {
+                         auto message = chan->try_recv();
+                         if (message.has_value()) {
+                             return attach(ctx, move(*message));
+                         } else if (chan->is_closed()) {
+                             // only waits for sends that are under way
+                             return receive(ctx, move(chan));
+                         } else {
+                             return empty(ctx);
+                         }
+                     })
+            );
+        obj->set("close",
+                 Function::native_expanded<Channel>(
+                     [](Ctx, auto chan) {
+                         chan->close();
+                         return Unit{};
+                     })
+            );
+        obj->set("closed",
+                 Function::native_expanded<Channel>(
+                     [](Ctx, auto chan) {
+                         return chan->is_closed();
+                     })
+            );
+        obj->set("__iter",
+                 Function::native_expanded<Channel>(
+                     [](Ctx, auto chan) {
+                         return chan;
+                     })
+            );
+        obj->set("__next",
+                 Function::native_expanded<Channel>(
+                     [](Ctx ctx, auto chan) {
+                         return receive(ctx, move(chan));
+                     })
+            );
+
+        return obj;
+    }
+}
@@ -0,0 +1,490 @@
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include <exec/collections.hpp>
+#include <exec/iterator.hpp>
+#include <exec/format.hpp>
+#include <exec/context.hpp>
+
+using namespace std;
+using namespace ejdi::exec::value;
+using namespace ejdi::exec::context;
+
+using Ctx = Context&;
+
+namespace ejdi::exec::collections {
+    // murmur3's finalizer
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdull;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ull;
+        x ^= x >> 33;
+        return x;
+    }
+
+    // Eight bytes per step, then the finalizer.
+    static uint64_t hash_bytes(const char* data, size_t size) {
+        uint64_t h = 0x9e3779b97f4a7c15ull ^ size;
+        for (; size >= 8; data += 8, size -= 8) {
+            uint64_t word;
+            memcpy(&word, data, 8);
+            h = ((h << 5 | h >> 59) ^ word) * 0x100000001b3ull;
+        }
+
+        uint64_t tail = 0;
+        memcpy(&tail, data, size);
+        return mix(h ^ tail);
+    }
+
+    static uint64_t hash_key(Ctx ctx, Value& key) {
+        if (key.is<float>()) {
+            auto x = key.as<float>();
+            // every NaN is the same key, and so are 0 and -0
+            if (isnan(x)) {
+                x = numeric_limits<float>::quiet_NaN();
+            } else if (x == 0) {
+                x = 0;
+            }
+
+            uint32_t bits;
+            memcpy(&bits, &x, sizeof(bits));
+            return mix(bits);
+        } else if (key.is<string>()) {
+            auto& str = *key.as<string>();
+            return hash_bytes(str.data(), str.size());
+        } else if (key.is<bool>()) {
+            return mix(0x5bd1e995ull + key.as<bool>());
+        }
+
+        string msg = "keys must be numbers, strings or booleans, got ";
+        msg += visit([](auto& arg){ return __type_name(&arg); }, key.value);
+        throw ctx.error(move(msg));
+    }
+
+    static bool same_key(Value& a, Value& b) {
+        if (a.value.index() != b.value.index()) {
+            return false;
+        }
+
+        if (a.is<float>()) {
+            auto x = a.as<float>();
+            auto y = b.as<float>();
+            return x == y || (isnan(x) && isnan(y));
+        } else if (a.is<string>()) {
+            return *a.as<string>() == *b.as<string>();
+        } else {
+            return a.as<bool>() == b.as<bool>();
+        }
+    }
+
+
+    static constexpr size_t MIN_CAPACITY = 8;
+
+    static uint32_t slot_hash(uint64_t slot) {
+        return uint32_t(slot >> 32);
+    }
+
+    static size_t slot_index(uint64_t slot) {
+        return uint32_t(slot) - 1;
+    }
+
+    static uint64_t make_slot(uint64_t hash, size_t index) {
+        return (hash >> 32) << 32 | (index + 1);
+    }
+
+    size_t HashTable::mask() const {
+        return slots.size() - 1;
+    }
+
+    size_t HashTable::size() const {
+        return entries_.size();
+    }
+
+    vector<HashTable::Entry>& HashTable::entries() {
+        return entries_;
+    }
+
+    void HashTable::clear() {
+        entries_.clear();
+        slots.assign(slots.size(), 0);
+    }
+
+    // Returns the slot holding `key`, or the empty slot where it belongs.
+    size_t HashTable::find_slot(Ctx, Value& key, uint64_t hash) {
+        auto fingerprint = uint32_t(hash >> 32);
+        for (auto i = fingerprint & mask();; i = (i + 1) & mask()) {
+            auto slot = slots[i];
+            if (slot == 0) {
+                return i;
+            }
+            if (slot_hash(slot) == fingerprint && same_key(entries_[slot_index(slot)].key, key)) {
+                return i;
+            }
+        }
+    }
+
+    void HashTable::place(uint64_t hash, size_t index) {
+        auto i = uint32_t(hash >> 32) & mask();
+        while (slots[i] != 0) {
+            i = (i + 1) & mask();
+        }
+        slots[i] = make_slot(hash, index);
+    }
+
+    void HashTable::rehash(size_t capacity) {
+        slots.assign(capacity, 0);
+        for (size_t i = 0; i < entries_.size(); i++) {
+            place(entries_[i].hash, i);
+        }
+    }
+
+    // Keeps the load factor at or below 3/4.
+    void HashTable::reserve(size_t size) {
+        if (size > numeric_limits<uint32_t>::max() - 1) {
+            throw error::RuntimeError { "hash table is too large" };
+        }
+
+        auto capacity = max(slots.size(), MIN_CAPACITY);
+        while (size * 4 > capacity * 3) {
+            capacity *= 2;
+        }
+
+        entries_.reserve(size);
+        if (capacity != slots.size()) {
+            rehash(capacity);
+        }
+    }
+
+    HashTable::Entry* HashTable::find(Ctx ctx, Value& key) {
+        auto hash = hash_key(ctx, key);
+        if (slots.empty()) {
+            return nullptr;
+        }
+
+        auto slot = slots[find_slot(ctx, key, hash)];
+        return slot == 0 ? nullptr : &entries_[slot_index(slot)];
+    }
+
+    HashTable::Entry& HashTable::insert(Ctx ctx, Value key, bool& inserted) {
+        auto hash = hash_key(ctx, key);
+        if (slots.empty()) {
+            rehash(MIN_CAPACITY);
+        }
+
+        auto i = find_slot(ctx, key, hash);
+        if (slots[i] != 0) {
+            inserted = false;
+            return entries_[slot_index(slots[i])];
+        }
+
+        inserted = true;
+        entries_.push_back(Entry { move(key), Unit{}, hash });
+        if (entries_.size() * 4 > slots.size() * 3) {
+            reserve(entries_.size());
+        } else {
+            slots[i] = make_slot(hash, entries_.size() - 1);
+        }
+        return entries_.back();
+    }
+
+    bool HashTable::erase(Ctx ctx, Value& key) {
+        auto hash = hash_key(ctx, key);
+        if (slots.empty()) {
+            return false;
+        }
+
+        auto hole = find_slot(ctx, key, hash);
+        if (slots[hole] == 0) {
+            return false;
+        }
+        auto index = slot_index(slots[hole]);
+
+        // backward-shift deletion: pull later slots of the probe run into
+        // the hole unless that would put them before their home slot
+        for (auto i = (hole + 1) & mask(); slots[i] != 0; i = (i + 1) & mask()) {
+            auto home = slot_hash(slots[i]) & mask();
+            if (((i - home) & mask()) >= ((i - hole) & mask())) {
+                slots[hole] = slots[i];
+                hole = i;
+            }
+        }
+        slots[hole] = 0;
+
+        // move the last entry into the gap and repoint its slot
+        auto last = entries_.size() - 1;
+        if (index != last) {
+            entries_[index] = move(entries_[last]);
+
+            auto fingerprint = uint32_t(entries_[index].hash >> 32);
+            auto i = fingerprint & mask();
+            while (slot_index(slots[i]) != last) {
+                i = (i + 1) & mask();
+            }
+            slots[i] = make_slot(entries_[index].hash, index);
+        }
+        entries_.pop_back();
+
+        return true;
+    }
+
+    HashTable HashTable::transfer(const CopyValue& copy) const {
+        HashTable res;
+        res.slots = slots;
+        res.entries_.reserve(entries_.size());
+        for (auto entry : entries_) {
+            res.entries_.push_back(Entry { copy(entry.key), copy(entry.value), entry.hash });
+        }
+
+        return res;
+    }
+
+
+    string_view Map::type_name() const {
+        return NAME;
+    }
+
+    string_view Map::vtable_name() const {
+        return "Map";
+    }
+
+    shared_ptr<Native> Map::transfer(const shared_ptr<Native>&, const CopyValue& copy) const {
+        auto res = make_shared<Map>();
+        res->table = table.transfer(copy);
+        return res;
+    }
+
+    string_view Set::type_name() const {
+        return NAME;
+    }
+
+    string_view Set::vtable_name() const {
+        return "Set";
+    }
+
+    shared_ptr<Native> Set::transfer(const shared_ptr<Native>&, const CopyValue& copy) const {
+        auto res = make_shared<Set>();
+        res->table = table.transfer(copy);
+        return res;
+    }
+
+    Value make_map(Ctx ctx, vector<Value> args) {
+        auto map = make_shared<Map>();
+        if (args.empty()) {
+            return map;
+        }
+
+        auto& pairs = *args[0].as<Array>();
+        map->table.reserve(pairs.size());
+        for (auto& pair : pairs) {
+            auto& kv = *pair.as<Array>();
+            if (kv.size() != 2) {
+                throw ctx.error("map entries must be [key, value] arrays");
+            }
+
+            bool inserted;
+            map->table.insert(ctx, kv[0], inserted).value = kv[1];
+        }
+
+        return map;
+    }
+
+    Value make_set(Ctx ctx, vector<Value> args) {
+        auto set = make_shared<Set>();
+        if (args.empty()) {
+            return set;
+        }
+
+        auto& elems = *args[0].as<Array>();
+        set->table.reserve(elems.size());
+        for (auto& elem : elems) {
+            bool inserted;
+            set->table.insert(ctx, elem, inserted);
+        }
+
+        return set;
+    }
+
+    using format::to_s;
+
+    // Methods that Map and Set share; `T` is either of them.
+    template< typename T >
+    static void common_methods(Object& obj) {
+        obj.set("len",
+                Function::native_expanded<T>(
+                    [](Ctx, auto coll) {
+                        return (float)coll->table.size();
+                    })
+            );
+        obj.set("has",
+                Function::native_expanded<T, Value>(
+                    [](Ctx ctx, auto coll, Value key) {
+                        return coll->table.find(ctx, key) != nullptr;
+                    })
+            );
+        obj.set("delete",
+                Function::native_expanded<T, Value>(
+                    [](Ctx ctx, auto coll, Value key) {
+                        return coll->table.erase(ctx, key);
+                    })
+            );
+        obj.set("reserve",
+                Function::native_expanded<T, float>(
+                    [](Ctx ctx, auto coll, float size) {
+                        // an entry and about two slots per element
+                        auto bytes = sizeof(HashTable::Entry) + 2 * sizeof(uint64_t);
+                        coll->table.reserve(to_capacity(ctx, size, bytes, "invalid capacity"));
+                        return Unit{};
+                    })
+            );
+        obj.set("clear",
+                Function::native_expanded<T>(
+                    [](Ctx, auto coll) {
+                        coll->table.clear();
+                        return Unit{};
+                    })
+            );
+    }
+
+    // Iterates over the entries by index, so deleting during iteration may
+    // skip the entry that was moved into the gap.
+    template< typename T, typename F >
+    static Value iterate(shared_ptr<T> coll, F elem) {
+        return iterator::make(
+            [coll, elem, i = size_t(0)](Ctx) mutable -> optional<Value> {
+                auto& entries = coll->table.entries();
+                if (i < entries.size()) {
+                    return elem(entries[i++]);
+                } else {
+                    return nullopt;
+                }
+            });
+    }
+
+    Value map_prototype() {
+        auto obj = make_shared<Object>();
+        common_methods<Map>(*obj);
+        obj->set("to_s",
+                 Function::native_expanded<Map>(
+                     [](Ctx ctx, auto map) {
+                         string res = "{";
+                         for (auto& entry : map->table.entries()) {
+                             if (res.size() > 1) {
+                                 res += ", ";
+                             }
+                             res += to_s(ctx, entry.key);
+                             res += ": ";
+                             res += to_s(ctx, entry.value);
+                         }
+                         res += '}';
+
+                         return res;
+                     })
+            );
+        obj->set("get",
+                 Function::native(
+                     [](Ctx ctx, vector<Value> args) -> Value {
+                         if (args.size() < 2) {
+                             throw ctx.arg_count_error(2, args.size());
+                         }
+
+                         auto entry = args[0].as<Map>()->table.find(ctx, args[1]);
+                         if (entry != nullptr) {
+                             return entry->value;
+                         }
+                         // the default, if there is one
+                         return args.size() > 2 ? move(args[2]) : Unit{};
+                     })
+            );
+        obj->set("set",
+                 Function::native_expanded<Map, Value, Value>(
+                     [](Ctx ctx, auto map, Value key, Value val) {
+                         bool inserted;
+                         map->table.insert(ctx, move(key), inserted).value = move(val);
+                         return Unit{};
+                     })
+            );
+        obj->set("keys",
+                 Function::native_expanded<Map>(
+                     [](Ctx, auto map) {
+                         auto res = make_shared<Array>();
+                         res->reserve(map->table.size());
+                         for (auto& entry : map->table.entries()) {
+                             res->push_back(entry.key);
+                         }
+                         return res;
+                     })
+            );
+        obj->set("values",
+                 Function::native_expanded<Map>(
+                     [](Ctx, auto map) {
+                         auto res = make_shared<Array>();
+                         res->reserve(map->table.size());
+                         for (auto& entry : map->table.entries()) {
+                             res->push_back(entry.value);
+                         }
+                         return res;
+                     })
+            );
+        obj->set("__iter",
+                 Function::native_expanded<Map>(
+                     [](Ctx, auto map) {
+                         return iterate(map, [](HashTable::Entry& entry) {
+                             return Value(make_shared<Array>(Array { entry.key, entry.value }));
+                         });
+                     })
+            );
+
+        return obj;
+    }
+
+    Value set_prototype() {
+        auto obj = make_shared<Object>();
+        common_methods<Set>(*obj);
+        obj->set("to_s",
+                 Function::native_expanded<Set>(
+                     [](Ctx ctx, auto set) {
+                         string res = "{";
+                         for (auto& entry : set->table.entries()) {
+                             if (res.size() > 1) {
+                                 res += ", ";
+                             }
+                             res += to_s(ctx, entry.key);
+                         }
+                         res += '}';
+
+                         return res;
+                     })
+            );
+        obj->set("add",
+                 Function::native_expanded<Set, Value>(
+                     [](Ctx ctx, auto set, Value key) {
+                         bool inserted;
+                         set->table.insert(ctx, move(key), inserted);
+                         return inserted;
+                     })
+            );
+        obj->set("to_array",
+                 Function::native_expanded<Set>(
+                     [](Ctx, auto set) {
+                         auto res = make_shared<Array>();
+                         res->reserve(set->table.size());
+                         for (auto& entry : set->table.entries()) {
+                             res->push_back(entry.key);
+                         }
+                         return res;
+                     })
+            );
+        obj->set("__iter",
+                 Function::native_expanded<Set>(
+                     [](Ctx, auto set) {
+                         return iterate(set, [](HashTable::Entry& entry) {
+                             return entry.key;
+                         });
+                     })
+            );
+
+        return obj;
+    }
+}
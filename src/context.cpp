@@ -1,9 +1,26 @@
 #include <iostream>
 #include <cmath>
 #include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <iterator>
+#include <limits>
 
 #include <exec/context.hpp>
 #include <exec/exec.hpp>
+#include <exec/isolate.hpp>
+#include <exec/channel.hpp>
+#include <exec/scheduler.hpp>
+#include <exec/parallel.hpp>
+#include <exec/iterator.hpp>
+#include <exec/numbers.hpp>
+#include <exec/sort.hpp>
+#include <exec/collections.hpp>
+#include <exec/strings.hpp>
+#include <exec/regex.hpp>
+#include <exec/format.hpp>
+#include <exec/fs.hpp>
+#include <exec/json.hpp>
 #include <util.hpp>
 #include <lexer.hpp>
 #include <lexem_groups.hpp>
@@ -38,18 +55,7 @@ static Value number() {
     obj->set("to_s",
              Function::native_expanded<float>(
                 [](Ctx, float val) {
-                    auto str = to_string(val);
-
-                    if (str.find('.') != string::npos) {
-                        while (str.back() == '0') {
-                            str.pop_back();
-                        }
-                        if (str.back() == '.') {
-                            str.pop_back();
-                        }
-                    }
-
-                    return str;
+                    return ejdi::exec::format::number(val);
                 })
         );
     obj->set("ceil",
@@ -111,11 +117,11 @@ static Value string_() {
     obj->set("to_n",
              Function::native_expanded<string>(
                  [](Ctx, auto val) -> Value {
-                     try {
-                         return stof(*val);
-                     } catch (...) {
+                     auto num = parse_number(ejdi::exec::strings::trim(*val));
+                     if (!num.has_value()) {
                          return Unit{};
                      }
+                     return *num;
                  })
         );
     obj->set("ord",
@@ -136,25 +142,117 @@ static Value string_() {
         );
     obj->set("at",
              Function::native_expanded<string, float>(
-                 [](Ctx ctx, auto str, size_t index) {
-                     string res;
-                     if (str->length() > index) {
-                         res += (str->at(index));
-                         return res;
-                     } else {
-                         throw ctx.error("string index out of range");
-                     }
+                 [](Ctx ctx, auto str, float index) {
+                     return char_string((*str)[to_index(ctx, index, str->length(), "string index out of range")]);
                  })
         );
     obj->set("slice",
              Function::native_expanded<string, float, float>(
-                 [](Ctx ctx, auto str, size_t start, size_t end) {
-                     if (start > end) {
-                         throw ctx.error("start index is higher than end index");
-                     } else if (str->length() <= start || str->length() < end) {
-                         throw ctx.error("string index out of range");
+                 [](Ctx ctx, auto str, float start_, float end_) {
+                     auto end = to_index(ctx, end_, str->length() + 1, "string index out of range");
+                     auto start = to_index(ctx, start_, end + 1, "start index is higher than end index");
+
+                     // strings own their bytes, so anything but the whole
+                     // string or a single character is copied
+                     //TODO: return (owner, offset, length) views for long
+                     // slices. Every string method and operator has to read
+                     // a view without copying it first, or a slice that is
+                     // used twice costs more than it does now.
+                     if (start == 0 && end == str->length()) {
+                         return str;
+                     } else if (end - start == 1) {
+                         return char_string((*str)[start]);
                      }
-                     return str->substr(start, end);
+                     return make_shared<string>(*str, start, end - start);
+                 })
+        );
+    obj->set("__iter",
+             Function::native_expanded<string>(
+                 [](Ctx, auto str) {
+                     return ejdi::exec::iterator::make(
+                         [str, i = size_t(0)](Ctx) mutable -> optional<Value> {
+                             if (i < str->size()) {
+                                 return Value(char_string((*str)[i++]));
+                             } else {
+                                 return nullopt;
+                             }
+                         });
+                 })
+        );
+    obj->set("find",
+             Function::native_expanded<string, string>(
+                 [](Ctx, auto str, auto needle) -> Value {
+                     auto pos = ejdi::exec::strings::find(*str, *needle);
+                     return pos == string::npos ? Value(Unit{}) : Value(float(pos));
+                 })
+        );
+    obj->set("rfind",
+             Function::native_expanded<string, string>(
+                 [](Ctx, auto str, auto needle) -> Value {
+                     auto pos = ejdi::exec::strings::rfind(*str, *needle);
+                     return pos == string::npos ? Value(Unit{}) : Value(float(pos));
+                 })
+        );
+    obj->set("contains",
+             Function::native_expanded<string, string>(
+                 [](Ctx, auto str, auto needle) {
+                     return ejdi::exec::strings::find(*str, *needle) != string::npos;
+                 })
+        );
+    obj->set("starts_with",
+             Function::native_expanded<string, string>(
+                 [](Ctx, auto str, auto prefix) {
+                     return starts_with(*str, *prefix);
+                 })
+        );
+    obj->set("ends_with",
+             Function::native_expanded<string, string>(
+                 [](Ctx, auto str, auto suffix) {
+                     return str->size() >= suffix->size()
+                         && str->compare(str->size() - suffix->size(), suffix->size(), *suffix) == 0;
+                 })
+        );
+    obj->set("split",
+             Function::native_expanded<string, string>(
+                 [](Ctx ctx, auto str, auto sep) {
+                     if (sep->empty()) {
+                         throw ctx.error("separator can't be empty");
+                     }
+                     return ejdi::exec::strings::split(*str, *sep);
+                 })
+        );
+    obj->set("replace",
+             Function::native_expanded<string, string, string>(
+                 [](Ctx ctx, auto str, auto from, auto to) {
+                     if (from->empty()) {
+                         throw ctx.error("pattern can't be empty");
+                     }
+                     return ejdi::exec::strings::replace(*str, *from, *to);
+                 })
+        );
+    obj->set("lines",
+             Function::native_expanded<string>(
+                 [](Ctx, auto str) {
+                     return ejdi::exec::strings::lines(*str);
+                 })
+        );
+    obj->set("trim",
+             Function::native_expanded<string>(
+                 [](Ctx, auto str) {
+                     auto trimmed = ejdi::exec::strings::trim(*str);
+                     return trimmed.size() == str->size() ? str : make_shared<string>(trimmed);
+                 })
+        );
+    obj->set("upper",
+             Function::native_expanded<string>(
+                 [](Ctx, auto str) {
+                     return ejdi::exec::strings::upper(*str);
+                 })
+        );
+    obj->set("lower",
+             Function::native_expanded<string>(
+                 [](Ctx, auto str) {
+                     return ejdi::exec::strings::lower(*str);
                  })
         );
 
@@ -185,26 +283,50 @@ static Value object() {
     return obj;
 }
 
+// Appends the elements of `src` to `dst`, stealing them when nobody else
+// holds the source array.
+static void append(Array& dst, shared_ptr<Array> src) {
+    if (src.use_count() == 1 && !src->frozen) {
+        dst.insert(dst.end(), make_move_iterator(src->begin()), make_move_iterator(src->end()));
+    } else if (&dst == src.get()) {
+        auto size = dst.size();
+        dst.reserve(size * 2);
+        copy_n(dst.begin(), size, back_inserter(dst));
+    } else {
+        dst.insert(dst.end(), src->begin(), src->end());
+    }
+}
+
+// Checks an index into an array of `size` elements. Positions one past the
+// end are valid where something can be inserted there.
+static size_t array_index(Ctx ctx, float index, size_t size, bool past_end = false) {
+    return to_index(ctx, index, past_end ? size + 1 : size, "array index out of bounds");
+}
+
 static Value array_() {
     auto obj = make_shared<Object>();
     obj->set("to_s",
-             Function::native_expanded<Array>(
-                 [](Ctx ctx, auto arr) {
-                     string res = "[";
-                     for (auto& elem : *arr) {
-                         res += *get_vtable(ctx, elem)
-                             .getf("to_s")
-                             .call(ctx, { elem })
-                             .template as<string>();
-
-                         res += ", ";
-                     }
-                     if (!arr->empty()) {
-                         res.pop_back();
-                         res.pop_back();
+             Function::native_expanded<Value>(
+                 [](Ctx ctx, Value arr) {
+                     return ejdi::exec::format::to_s(ctx, arr);
+                 })
+        );
+    obj->set("join",
+             Function::native_expanded<Array, string>(
+                 [](Ctx ctx, auto arr, auto sep) {
+                     string res;
+                     for (size_t i = 0; i < arr->size(); i++) {
+                         if (i > 0) {
+                             res += *sep;
+                         }
+
+                         auto elem = (*arr)[i];
+                         if (elem.template is<string>()) {
+                             res += *elem.template as<string>();
+                         } else {
+                             res += ejdi::exec::format::to_s(ctx, elem);
+                         }
                      }
-                     res += ']';
-
                      return res;
                  })
         );
@@ -222,6 +344,7 @@ static Value array_() {
                      }
 
                      auto& arr = val[0].as<Array>();
+                     arr->ensure_mutable();
 
                      for (auto iter = next(val.begin()); iter != val.end(); ++iter) {
                          arr->push_back(move(*iter));
@@ -233,6 +356,7 @@ static Value array_() {
     obj->set("pop",
              Function::native_expanded<Array>(
                  [](Ctx, auto arr) -> Value {
+                     arr->ensure_mutable();
                      if (arr->empty()) {
                          return Unit{};
                      }
@@ -244,33 +368,302 @@ static Value array_() {
         );
     obj->set("at",
              Function::native_expanded<Array, float>(
-                 [](Ctx ctx, auto arr, size_t index) {
-                     if (arr->size() < index) {
-                         throw ctx.error("array index out of bounds");
-                     }
-
-                     return (*arr)[index];
+                 [](Ctx ctx, auto arr, float index) {
+                     return (*arr)[array_index(ctx, index, arr->size())];
                  })
         );
     obj->set("set",
              Function::native_expanded<Array, float, Value>(
-                 [](Ctx ctx, auto arr, size_t index, Value val) {
-                     if (arr->size() < index) {
-                         throw ctx.error("array index out of bounds");
+                 [](Ctx ctx, auto arr, float index, Value val) {
+                     arr->ensure_mutable();
+                     (*arr)[array_index(ctx, index, arr->size())] = move(val);
+
+                     return Unit{};
+                 })
+        );
+    obj->set("slice",
+             Function::native_expanded<Array, float, float>(
+                 [](Ctx ctx, auto arr, float start_, float end_) {
+                     auto end = array_index(ctx, end_, arr->size(), true);
+                     auto start = array_index(ctx, start_, end, true);
+
+                     auto first = arr->begin() + start;
+                     auto last = arr->begin() + end;
+                     if (arr.use_count() == 1 && !arr->frozen) {
+                         return make_shared<Array>(make_move_iterator(first), make_move_iterator(last));
+                     }
+                     return make_shared<Array>(first, last);
+                 })
+        );
+    obj->set("concat",
+             Function::native(
+                 [](Ctx ctx, vector<Value> args) {
+                     if (args.size() == 0) {
+                         throw ctx.arg_count_error(1, 0);
                      }
 
-                     (*arr)[index] = move(val);
+                     size_t size = 0;
+                     for (auto& arg : args) {
+                         size += arg.as<Array>()->size();
+                     }
+
+                     auto res = make_shared<Array>();
+                     res->reserve(size);
+                     for (auto& arg : args) {
+                         append(*res, move(arg.as<Array>()));
+                     }
+
+                     return res;
+                 })
+        );
+    obj->set("extend",
+             Function::native(
+                 [](Ctx ctx, vector<Value> args) {
+                     if (args.size() == 0) {
+                         throw ctx.arg_count_error(1, 0);
+                     }
+
+                     auto arr = args[0].as<Array>();
+                     arr->ensure_mutable();
+
+                     auto size = arr->size();
+                     for (auto iter = next(args.begin()); iter != args.end(); ++iter) {
+                         size += iter->as<Array>()->size();
+                     }
+                     arr->reserve(size);
+
+                     for (auto iter = next(args.begin()); iter != args.end(); ++iter) {
+                         append(*arr, move(iter->as<Array>()));
+                     }
 
                      return Unit{};
                  })
         );
+    obj->set("splice",
+             Function::native(
+                 [](Ctx ctx, vector<Value> args) {
+                     if (args.size() < 3) {
+                         throw ctx.arg_count_error(3, args.size());
+                     }
 
-    return obj;
-}
+                     auto& arr = args[0].as<Array>();
+                     arr->ensure_mutable();
+
+                     auto start = array_index(ctx, args[1].as<float>(), arr->size(), true);
+                     auto count = args[2].as<float>();
+                     if (!(count >= 0)) {
+                         throw ctx.error("can't remove a negative number of elements");
+                     }
+                     // clamped before the cast, which would overflow on huge counts
+                     auto rest = arr->size() - start;
+                     auto first = arr->begin() + start;
+                     auto last = first + (count < rest ? size_t(count) : rest);
+
+                     auto removed = make_shared<Array>(make_move_iterator(first), make_move_iterator(last));
+
+                     // overwrite the removed range in place, then insert or
+                     // erase whatever doesn't fit
+                     auto items = args.begin() + 3;
+                     auto overlap = min<size_t>(last - first, args.end() - items);
+                     auto pos = move(items, items + overlap, first);
+                     if (pos != last) {
+                         arr->erase(pos, last);
+                     } else {
+                         arr->insert(pos, make_move_iterator(items + overlap), make_move_iterator(args.end()));
+                     }
+
+                     return removed;
+                 })
+        );
+    obj->set("reverse",
+             Function::native_expanded<Array>(
+                 [](Ctx, auto arr) {
+                     arr->ensure_mutable();
+                     reverse(arr->begin(), arr->end());
+                     return Unit{};
+                 })
+        );
+    obj->set("insert",
+             Function::native(
+                 [](Ctx ctx, vector<Value> args) {
+                     if (args.size() < 2) {
+                         throw ctx.arg_count_error(2, args.size());
+                     }
+
+                     auto& arr = args[0].as<Array>();
+                     arr->ensure_mutable();
+
+                     auto pos = arr->begin() + array_index(ctx, args[1].as<float>(), arr->size(), true);
+                     arr->insert(pos, make_move_iterator(args.begin() + 2), make_move_iterator(args.end()));
+
+                     return Unit{};
+                 })
+        );
+    obj->set("remove",
+             Function::native_expanded<Array, float>(
+                 [](Ctx ctx, auto arr, float index) {
+                     arr->ensure_mutable();
+
+                     auto pos = arr->begin() + array_index(ctx, index, arr->size());
+                     auto ret = move(*pos);
+                     arr->erase(pos);
+                     return ret;
+                 })
+        );
+    obj->set("reserve",
+             Function::native_expanded<Array, float>(
+                 [](Ctx ctx, auto arr, float capacity) {
+                     arr->ensure_mutable();
+                     arr->reserve(to_capacity(ctx, capacity, sizeof(Value), "invalid array capacity"));
+                     return Unit{};
+                 })
+        );
+    obj->set("truncate",
+             Function::native_expanded<Array, float>(
+                 [](Ctx ctx, auto arr, float size) {
+                     arr->ensure_mutable();
+
+                     arr->resize(array_index(ctx, size, arr->size(), true), Unit{});
+                     return Unit{};
+                 })
+        );
+    obj->set("sort",
+             Function::native(
+                 [](Ctx ctx, vector<Value> args) {
+                     if (args.size() == 0) {
+                         throw ctx.arg_count_error(1, 0);
+                     }
+
+                     auto cmp = args.size() > 1 ? args[1].as<Function>() : nullptr;
+                     ejdi::exec::sort::sort(ctx, args[0].as<Array>(), move(cmp));
+                     return Unit{};
+                 })
+        );
+    obj->set("sort_by",
+             Function::native_expanded<Array, Function>(
+                 [](Ctx ctx, auto arr, auto key) {
+                     ejdi::exec::sort::sort_by(ctx, move(arr), move(key));
+                     return Unit{};
+                 })
+        );
+    obj->set("__iter",
+             Function::native_expanded<Array>(
+                 [](Ctx, auto arr) {
+                     return ejdi::exec::iterator::make(
+                         [arr, i = size_t(0)](Ctx) mutable -> optional<Value> {
+                             if (i < arr->size()) {
+                                 return (*arr)[i++];
+                             } else {
+                                 return nullopt;
+                             }
+                         });
+                 })
+        );
+    obj->set("map",
+             Function::native_expanded<Array, Function>(
+                 [](Ctx ctx, auto arr, auto func) {
+                     auto res = make_shared<Array>();
+                     res->reserve(arr->size());
+                     for (size_t i = 0; i < arr->size(); i++) {
+                         res->push_back(func->call(ctx, { (*arr)[i] }));
+                     }
+
+                     return res;
+                 })
+        );
+    obj->set("filter",
+             Function::native_expanded<Array, Function>(
+                 [](Ctx ctx, auto arr, auto func) {
+                     auto res = make_shared<Array>();
+                     res->reserve(arr->size());
+                     for (size_t i = 0; i < arr->size(); i++) {
+                         auto elem = (*arr)[i];
+                         if (func->call(ctx, { elem }).template as<bool>()) {
+                             res->push_back(move(elem));
+                         }
+                     }
+                     res->shrink_to_fit();
+
+                     return res;
+                 })
+        );
+    obj->set("reduce",
+             Function::native(
+                 [](Ctx ctx, vector<Value> args) -> Value {
+                     if (args.size() < 2) {
+                         throw ctx.arg_count_error(2, args.size());
+                     }
+
+                     auto arr = args[0].as<Array>();
+                     auto func = args[1].as<Function>();
+
+                     size_t i = 0;
+                     Value acc = Unit{};
+                     if (args.size() > 2) {
+                         acc = move(args[2]);
+                     } else if (!arr->empty()) {
+                         acc = (*arr)[0];
+                         i = 1;
+                     }
+
+                     for (; i < arr->size(); i++) {
+                         acc = func->call(ctx, { move(acc), (*arr)[i] });
+                     }
+
+                     return acc;
+                 })
+        );
+    obj->set("any",
+             Function::native_expanded<Array, Function>(
+                 [](Ctx ctx, auto arr, auto func) {
+                     for (size_t i = 0; i < arr->size(); i++) {
+                         if (func->call(ctx, { (*arr)[i] }).template as<bool>()) {
+                             return true;
+                         }
+                     }
+
+                     return false;
+                 })
+        );
+    obj->set("all",
+             Function::native_expanded<Array, Function>(
+                 [](Ctx ctx, auto arr, auto func) {
+                     for (size_t i = 0; i < arr->size(); i++) {
+                         if (!func->call(ctx, { (*arr)[i] }).template as<bool>()) {
+                             return false;
+                         }
+                     }
+
+                     return true;
+                 })
+        );
+    obj->set("find",
+             Function::native_expanded<Array, Function>(
+                 [](Ctx ctx, auto arr, auto func) -> Value {
+                     for (size_t i = 0; i < arr->size(); i++) {
+                         auto elem = (*arr)[i];
+                         if (func->call(ctx, { elem }).template as<bool>()) {
+                             return elem;
+                         }
+                     }
+
+                     return Unit{};
+                 })
+        );
+    obj->set("for_each",
+             Function::native_expanded<Array, Function>(
+                 [](Ctx ctx, auto arr, auto func) {
+                     for (size_t i = 0; i < arr->size(); i++) {
+                         func->call(ctx, { (*arr)[i] });
+                     }
+
+                     return Unit{};
+                 })
+        );
+    obj->set("par_map", Function::native_expanded<Array, Function>(ejdi::exec::parallel::par_map));
+    obj->set("par_filter", Function::native_expanded<Array, Function>(ejdi::exec::parallel::par_filter));
+    obj->set("par_reduce", Function::native_expanded<Array, Function, Value>(ejdi::exec::parallel::par_reduce));
 
-static Value iter() {
-    auto obj = make_shared<Object>();
-    obj->set("end", make_shared<Object>());
     return obj;
 }
 
@@ -281,7 +674,7 @@ namespace ejdi::exec::context {
     }
 
     RuntimeError Context::arg_count_error(size_t expected, size_t got, Span span) const {
-        string msg = "not enough arguments: need at least ";
+        string msg = got > expected ? "too many arguments: need at most " : "not enough arguments: need at least ";
         msg += to_string(expected);
         msg += ", got ";
         msg += to_string(got);
@@ -294,11 +687,11 @@ namespace ejdi::exec::context {
         child_scope->prototype = scope;
         child_scope->mutable_prototype_fields = true;
 
-        return Context { global, move(child_scope) };
+        return Context { global, move(child_scope), module_path, stack_trace };
     }
 
 
-    GlobalContext GlobalContext::with_core() {
+    GlobalContext GlobalContext::with_core(shared_ptr<isolate::Shared> shared) {
         auto core = make_shared<Object>();
 
         vector<tuple<string, function<Value()>>> prototypes = {
@@ -309,7 +702,16 @@ namespace ejdi::exec::context {
             { "Function", function_ },
             { "Object", object },
             { "Array", array_ },
-            { "Iterator", iter }
+            { "Iterator", iterator::prototype },
+            { "NumberArray", numbers::prototype },
+            { "Range", iterator::range_prototype },
+            { "Map", collections::map_prototype },
+            { "Set", collections::set_prototype },
+            { "Regex", regex::prototype },
+            { "File", fs::file_prototype },
+            { "Mapping", fs::mapping_prototype },
+            { "Channel", channel::prototype },
+            { "Future", scheduler::prototype }
         };
 
         auto prelude = make_shared<Object>();
@@ -324,23 +726,45 @@ namespace ejdi::exec::context {
             "print",
             Function::native(
                 [](Ctx ctx, vector<Value> args) {
+                    auto out = format::Writer(&ctx.global);
                     for (auto& val : args) {
-                        auto str = get_vtable(ctx, val).getf("to_s").call(ctx, {val});
-                        cout << *str.as<string>();
+                        out.value(ctx, val);
                     }
-                    cout.flush();
+                    out.finish();
+
+                    return Unit{};
+                })
+            );
 
+        prelude->set(
+            "flush",
+            Function::native_expanded(
+                [](Ctx ctx) {
+                    ctx.global.flush();
                     return Unit{};
                 })
             );
+        prelude->set(
+            "output_stats",
+            Function::native_expanded(
+                [](Ctx ctx) {
+                    auto stats = ctx.global.shared->out.stats();
+                    auto obj = make_shared<Object>();
+                    obj->prototype = ctx.global.core->get("Object").as<Object>();
+                    obj->set("bytes", float(stats.bytes));
+                    obj->set("syscalls", float(stats.syscalls));
+                    return obj;
+                })
+            );
 
         prelude->set(
             "readline",
             Function::native_expanded(
-                [](Ctx) {
-                    string ret;
-                    getline(cin, ret);
-                    return ret;
+                [](Ctx ctx) {
+                    // a prompt without a newline is still waiting in the buffer
+                    ctx.global.flush();
+
+                    return ctx.global.shared->in->read_line(ctx).value_or("");
                 })
             );
 
@@ -354,6 +778,86 @@ namespace ejdi::exec::context {
                 })
             );
 
+        prelude->set("numbers", Function::native_expanded<Value>(numbers::make));
+        prelude->set("range", Function::native(iterator::range));
+        prelude->set(
+            "iter",
+            Function::native_expanded<Value>(
+                [](Ctx ctx, Value val) -> Value {
+                    return iterator::from(ctx, move(val));
+                })
+            );
+        prelude->set("map", Function::native(collections::make_map));
+        prelude->set("set", Function::native(collections::make_set));
+        prelude->set(
+            "regex",
+            Function::native_expanded<string>(
+                [](Ctx ctx, auto pattern) {
+                    return regex::compile(ctx, *pattern);
+                })
+            );
+        prelude->set("json", json::module(core));
+
+        prelude->set(
+            "freeze",
+            Function::native_expanded<Value>(
+                [](Ctx ctx, Value val) {
+                    freeze(ctx, val);
+                    return val;
+                })
+            );
+
+        prelude->set(
+            "frozen",
+            Function::native_expanded<Value>(
+                [](Ctx, Value val) {
+                    if (val.is<Array>()) {
+                        return val.as<Array>()->frozen;
+                    } else if (val.is<Object>()) {
+                        return val.as<Object>()->frozen;
+                    } else {
+                        return !val.is<Native>();
+                    }
+                })
+            );
+
+        prelude->set(
+            "channel",
+            Function::native(
+                [](Ctx ctx, vector<Value> args) -> Value {
+                    if (args.size() == 0) {
+                        throw ctx.arg_count_error(1, 0);
+                    }
+
+                    auto capacity = to_index(ctx, args[0].as<float>(), channel::Channel::MAX_CAPACITY + 1,
+                                             "channel capacity must be between 1 and 2^24");
+                    if (capacity < 1) {
+                        throw ctx.error("channel capacity must be between 1 and 2^24");
+                    }
+
+                    if (args.size() > 1) {
+                        auto& name = args[1].as<string>();
+                        return ctx.global.shared->named_channel(*name, capacity);
+                    } else {
+                        return make_shared<channel::Channel>(capacity);
+                    }
+                })
+            );
+
+        prelude->set("spawn", Function::native(scheduler::spawn));
+        prelude->set("await", Function::native_expanded<scheduler::Future>(scheduler::await));
+        prelude->set("join_all", Function::native_expanded<Array>(scheduler::join_all));
+
+        prelude->set(
+            "clock",
+            Function::native_expanded(
+                [](Ctx) {
+                    using namespace std::chrono;
+                    static const auto start = steady_clock::now();
+                    return duration<float>(steady_clock::now() - start).count();
+                })
+            );
+
         prelude->set(
             "require",
             Function::native_expanded<string>(
@@ -362,9 +866,24 @@ namespace ejdi::exec::context {
                 })
             );
 
+        auto isolate = make_shared<Object>();
+        isolate->set("id", 0.0f);
+        isolate->set("count", 1.0f);
+        prelude->set("isolate", move(isolate));
+
         core->set("prelude", move(prelude));
 
-        return GlobalContext { move(core), {}, {} };
+        if (shared == nullptr) {
+            shared = make_shared<isolate::Shared>();
+        }
+
+        auto global = GlobalContext { move(core), move(shared), {}, {} };
+        for (auto name : { "Unit", "Number", "Boolean", "String", "Array" }) {
+            auto proto = global.core->get(name).as<Object>();
+            global.builtin_to_s.push_back(proto->get("to_s").as<Function>());
+        }
+
+        return global;
     }
 
     shared_ptr<Object> GlobalContext::new_module(string name) {
@@ -385,6 +904,19 @@ namespace ejdi::exec::context {
             }
         };
 
+        // native modules, one instance per isolate. Their names are
+        // reserved: an fs.ejdi is only found as "./fs".
+        if (module == "fs") {
+            auto name = string(module);
+            auto maybe_module = modules.find(name);
+            if (maybe_module == modules.end()) {
+                auto mod = make_shared<Object>();
+                mod->set("exports", fs::module(*this));
+                maybe_module = modules.emplace(move(name), move(mod)).first;
+            }
+            return maybe_module->second->get("exports");
+        }
+
         path module_path;
         if (starts_with(module, "./")) {
             if (loading_from == nullptr) {
@@ -423,20 +955,11 @@ namespace ejdi::exec::context {
         }
 
         try {
-            auto file = ifstream(module_path);
-            string source { istreambuf_iterator<char>(file), {}};
-            linemaps.emplace(module_path, source);
-
-            auto lexems = lexer::actions::split_string(source, module_path);
-            auto group = lexer::groups::find_groups(move(lexems));
-            auto program = parser::parse_program(*group);
-            if (!program.has_result()) {
-                throw move(program.error());
-            }
+            auto source = shared->load_source(module_path);
             auto mod = new_module(module_path);
             mod->set("exports", Unit{});
             auto ctx = Context { *this, move(mod), module_path };
-            exec::exec_program(ctx, *program.get());
+            exec::exec_program(ctx, *source->program);
             return ctx.scope->get("exports");
         } catch (logic_error& e) {
             throw RuntimeError { e.what(), Span::empty(), stack_trace() };
@@ -449,11 +972,50 @@ namespace ejdi::exec::context {
         }
     }
 
-    void GlobalContext::print_error_message(const RuntimeError& error) const {
-        const auto& linemap = linemaps.at(error.root_span.file);
-        auto pos = linemap.span_to_pos_pair(error.root_span).first;
-        cerr << "ERROR in module " << error.root_span.file << "\n";
-        cerr << "  at " << pos.line+1 << ':' << pos.column << "\n";
-        cerr << "  " << error.root_error << endl;
+    void GlobalContext::print_error_message(const RuntimeError& error) {
+        string msg;
+        auto source = shared->find_source(error.root_span.file);
+        if (source == nullptr) {
+            msg += "ERROR\n";
+        } else {
+            auto pos = source->linemap.span_to_pos_pair(error.root_span).first;
+            msg += "ERROR in module " + error.root_span.file + "\n";
+            msg += "  at " + to_string(pos.line+1) + ':' + to_string(pos.column) + "\n";
+        }
+        msg += "  " + error.root_error + "\n";
+
+        // whatever was printed before the error comes first
+        flush();
+        shared->err.write(msg);
+        shared->err.flush();
+    }
+
+    void GlobalContext::write(string_view str) {
+        if (!line_serialized_output) {
+            shared->out.write(str);
+            return;
+        }
+
+        pending_output += str;
+
+        auto line_end = pending_output.rfind('\n');
+        if (line_end != string::npos) {
+            shared->out.write(string_view(pending_output).substr(0, line_end + 1));
+            pending_output.erase(0, line_end + 1);
+        }
+    }
+
+    void GlobalContext::flush() {
+        // a partial line an isolate holds back goes out too: it is a
+        // prompt, or the last words before an error
+        close_output();
+        shared->out.flush();
+    }
+
+    void GlobalContext::close_output() {
+        if (!pending_output.empty()) {
+            shared->out.write(pending_output);
+            pending_output.clear();
+        }
     }
 }
@@ -3,6 +3,7 @@
 
 #include <exec/exec.hpp>
 #include <exec/error.hpp>
+#include <exec/iterator.hpp>
 
 using namespace std;
 using namespace ejdi::ast;
@@ -11,6 +12,93 @@ using namespace ejdi::exec::context;
 using namespace ejdi::exec::error;
 
 namespace ejdi::exec {
+    // Whether `expr` reads the target of `assign`: the variable itself, or
+    // `v.f` for `v.f = ...`, where evaluating v a second time can't matter.
+    static bool reads_target(const Assignment& assign, const Expr& expr) {
+        if (!assign.base.has_value()) {
+            return ast_is<Variable>(expr) && ast_get<Variable>(expr)->variable.symbol == assign.field.symbol;
+        } else if (!ast_is<Variable>(*assign.base) || !ast_is<FieldAccess>(expr)) {
+            return false;
+        }
+
+        const auto& access = *ast_get<FieldAccess>(expr);
+        return access.field.symbol == assign.field.symbol
+            && ast_is<Variable>(access.base)
+            && ast_get<Variable>(access.base)->variable.symbol == ast_get<Variable>(*assign.base)->variable.symbol;
+    }
+
+    // `s = s ~ a ~ b;` and `o.s = o.s ~ a ~ b;` append to the string in s
+    // instead of copying it, so building a string in a loop takes linear
+    // time. The operands are still evaluated left to right; s is only
+    // reused if it's unchanged by then and nothing else holds its string.
+    // Returns false if the assignment isn't of that shape.
+    static bool append_assign(Context& ctx, const Assignment& assign) {
+        vector<const Expr*> parts;
+        const Expr* expr = &assign.expr;
+        while (ast_is<BinaryOp>(*expr) && ast_get<BinaryOp>(*expr)->op.str == "~") {
+            const auto& op = *std::get<Rc<BinaryOp>>(*expr);
+            parts.push_back(&op.right);
+            expr = &op.left;
+        }
+
+        if (parts.empty() || !reads_target(assign, *expr)) {
+            return false;
+        }
+
+        shared_ptr<Object> obj;
+        if (assign.base.has_value()) {
+            auto base = eval(ctx, *assign.base);
+            if (!base.is<Object>()) {
+                return false;
+            }
+            obj = base.as<Object>();
+        }
+
+        auto left = eval(ctx, *expr);
+        if (!left.is<string>()) {
+            return false;
+        }
+
+        size_t size = left.as<string>()->size();
+        vector<Value> rights;
+        try {
+            for (auto it = parts.rbegin(); it != parts.rend(); ++it) {
+                rights.push_back(eval(ctx, **it));
+                size += rights.back().as<string>()->size();
+            }
+        } catch (RuntimeError& e) {
+            e.set_span_once(ast_span(assign.expr));
+            throw;
+        }
+
+        // field storage may have moved, so the target is looked up again;
+        // a frozen object keeps its string and set() below raises the error
+        auto var = obj == nullptr
+            ? ctx.scope->try_get(assign.field.symbol)
+            : obj->frozen ? nullptr : obj->try_get_no_prototype(assign.field.symbol);
+        if (var != nullptr && var->is<string>() && var->as<string>() == left.as<string>()) {
+            *var = Unit{};
+        }
+
+        auto& str = left.as<string>();
+        if (!str.unique()) {
+            str = make_shared<string>(*str);
+        }
+        if (str->capacity() < size) {
+            str->reserve(max(size, str->capacity() * 2));
+        }
+        for (auto& right : rights) {
+            *str += *right.as<string>();
+        }
+
+        if (obj != nullptr) {
+            obj->set(assign.field.symbol, move(left));
+        } else {
+            *var = move(left);
+        }
+        return true;
+    }
+
     void exec_program(Context& ctx, const Program& prog) {
         for (const auto& stmt : prog.statements) {
             exec(ctx, stmt);
@@ -23,19 +111,24 @@ namespace ejdi::exec {
                 auto assign = ast_get<Assignment>(stmt);
 
                 if (assign->let.has_value() && !assign->base.has_value()) {
-                    if (ctx.scope->try_get_no_prototype(assign->field.str) == nullptr) {
-                        ctx.scope->set_no_prototype(assign->field.str, eval(ctx, assign->expr));
+                    if (ctx.scope->try_get_no_prototype(assign->field.symbol) == nullptr) {
+                        ctx.scope->set_no_prototype(assign->field.symbol, eval(ctx, assign->expr));
                     } else {
                         string msg = "variable with name '";
                         msg += assign->field.str;
                         msg += "' already exists in this scope";
                         throw ctx.error(move(msg), assign->field.span);
                     }
+                } else if (append_assign(ctx, *assign)) {
+                    return;
                 } else if (assign->base.has_value()) {
                     auto base = eval(ctx, *assign->base);
-                    base.as<Object>()->set(assign->field.str, eval(ctx, assign->expr));
+                    base.as<Object>()->set(assign->field.symbol, eval(ctx, assign->expr));
                 } else {
-                    auto var = ctx.scope->try_get(assign->field.str);
+                    // field storage may move while the expression runs, so
+                    // the variable is looked up afterwards
+                    auto value = eval(ctx, assign->expr);
+                    auto var = ctx.scope->try_get(assign->field.symbol);
                     if (var == nullptr) {
                         string msg = "variable '";
                         msg += assign->field.str;
@@ -43,7 +136,7 @@ namespace ejdi::exec {
                         throw ctx.error(move(msg), assign->field.span);
                     }
 
-                    *var = eval(ctx, assign->expr);
+                    *var = move(value);
                 }
             } else if (ast_is<ExprStmt>(stmt)) {
                 eval(ctx, ast_get<ExprStmt>(stmt)->expr);
@@ -63,7 +156,7 @@ namespace ejdi::exec {
         Value& right;
 
         int cmp(Unit) {
-            return true;
+            return right.is<Unit>() ? 0 : 1;
         }
 
         int cmp(float) {
@@ -83,31 +176,74 @@ namespace ejdi::exec {
         }
 
         int cmp(const shared_ptr<string>&) {
-            auto& a = left.as<string>();
-            auto& b = right.as<string>();
-
-            if (a->size() != b->size()) {
-                return false;
-            }
-
-            return strncmp(a->data(), b->data(), a->size());
+            return left.as<string>()->compare(*right.as<string>());
         }
 
+        // references are only ever equal or not equal
         int cmp(const shared_ptr<Function>&) {
-            return left.as<Function>() == right.as<Function>();
+            return left.as<Function>() == right.as<Function>() ? 0 : 1;
         }
 
         int cmp(const shared_ptr<Object>&) {
-            return left.as<Object>() == right.as<Object>();
+            return left.as<Object>() == right.as<Object>() ? 0 : 1;
         }
 
         int cmp(const shared_ptr<Array>&) {
-            return left.as<Array>() == right.as<Array>();
+            return left.as<Array>() == right.as<Array>() ? 0 : 1;
+        }
+
+        int cmp(const shared_ptr<Native>&) {
+            return left.as<Native>() == right.as<Native>() ? 0 : 1;
         }
 
         int compare() {
             return visit([this](const auto& x){ return this->cmp(x); }, left.value);
         }
+
+        // values of different types are never equal
+        bool equal() {
+            if (left.value.index() != right.value.index()) {
+                return false;
+            }
+            return compare() == 0;
+        }
+    };
+
+    int compare(Value& left, Value& right) {
+        return Comparator{ left, right }.compare();
+    }
+
+    // Runs a for loop's body once per element. The loop variable lives in a
+    // scope of its own and the body's locals in a child of it, so the body
+    // can shadow the variable. Both are reused between iterations unless
+    // something still holds on to the body's scope.
+    struct LoopBody {
+        Context vars;
+        Context body;
+        const ForLoop& loop;
+
+        LoopBody(Context vars, const ForLoop& loop)
+            : vars(vars)
+            , body(this->vars.child())
+            , loop(loop) {}
+
+        void operator()(Value elem) {
+            if (body.scope.use_count() > 1) {
+                vars.scope = Object::scope(vars.scope->prototype);
+                body.scope = Object::scope(vars.scope);
+            } else {
+                body.scope->fields.clear();
+            }
+            vars.scope->set_no_prototype(loop.variable.symbol, move(elem));
+
+            const auto& block = *loop.body;
+            for (const auto& stmt : block.statements) {
+                exec(body, stmt);
+            }
+            if (block.ret.has_value()) {
+                eval(body, *block.ret);
+            }
+        }
     };
 
     struct Evaluator {
@@ -115,7 +251,7 @@ namespace ejdi::exec {
 
 
         Value ev(const Variable& var) {
-            return ctx.scope->get(var.variable.str);
+            return ctx.scope->get(var.variable.symbol);
         }
 
         Value ev(const Block& block) {
@@ -163,9 +299,9 @@ namespace ejdi::exec {
             } else if (str == "||") {
                 return left.as<bool>() || right.as<bool>();
             } else if (str == "==") {
-                return Comparator{ left, right }.compare() == 0;
+                return Comparator{ left, right }.equal();
             } else if (str == "!=") {
-                return Comparator{ left, right }.compare() != 0;
+                return !Comparator{ left, right }.equal();
             } else if (str == "<") {
                 return Comparator{ left, right }.compare() < 0;
             } else if (str == ">") {
@@ -204,12 +340,12 @@ namespace ejdi::exec {
 
         Value ev(const FieldAccess& access) {
             auto base = eval(ctx, access.base);
-            return get_vtable(ctx, base).get(access.field.str);
+            return lookup(ctx, base, access.field.symbol);
         }
 
         Value ev(const MethodCall& method) {
             auto base = eval(ctx, method.base);
-            auto func = get_vtable(ctx, base).get(method.method.str).as<Function>();
+            auto func = lookup(ctx, base, method.method.symbol).as<Function>();
             vector<Value> args;
             args.reserve(method.arguments->list.size() + 1);
             args.push_back(move(base));
@@ -228,29 +364,58 @@ namespace ejdi::exec {
             return Unit{};
         }
 
+        // Arrays, strings, ranges and native iterators are walked directly;
+        // anything else goes through __iter and __next.
         Value ev(const ForLoop& loop) {
             auto iterable = eval(ctx, loop.iterable);
-            auto iter = get_vtable(ctx, iterable)
-                .getf("__iter")
-                .call(ctx, { iterable });
+            auto body = LoopBody(ctx.child(), loop);
+
+            if (iterable.is<Array>()) {
+                auto arr = iterable.as<Array>();
+                for (size_t i = 0; i < arr->size(); i++) {
+                    body((*arr)[i]);
+                }
+                return Unit{};
+            } else if (iterable.is<string>()) {
+                auto str = iterable.as<string>();
+                for (size_t i = 0; i < str->size(); i++) {
+                    body(char_string((*str)[i]));
+                }
+                return Unit{};
+            } else if (iterable.is<iterator::Range>()) {
+                auto range = iterable.as<iterator::Range>();
+                for (size_t i = 0; i < range->count; i++) {
+                    body(range->at(i));
+                }
+                return Unit{};
+            }
+
+            auto iter = lookupf(ctx, iterable, SYMBOL("__iter"))
+                ->call(ctx, { iterable });
+
+            if (iter.is<iterator::NativeIterator>()) {
+                auto native = iter.as<iterator::NativeIterator>();
+                while (auto elem = native->next(ctx)) {
+                    body(move(*elem));
+                }
+                return Unit{};
+            }
 
             auto enditer = ctx.global.core
-                ->get("Iterator")
+                ->get(SYMBOL("Iterator"))
                 .as<Object>()
-                ->get("end")
+                ->get(SYMBOL("end"))
                 .as<Object>();
-
-            auto loop_ctx = ctx.child();
-            auto evaluator = Evaluator { loop_ctx };
+            // held for the whole loop: the body may reassign __next
+            auto next = lookupf(ctx, iter, SYMBOL("__next"));
 
             while (true) {
-                auto elem = get_vtable(ctx, iter).getf("__next").call(ctx, { iter });
+                auto elem = next->call(ctx, { iter });
                 if (elem.is<Object>() && elem.as<Object>() == enditer) {
                     break;
                 }
 
-                loop_ctx.scope->set_no_prototype(loop.variable.str, move(elem));
-                evaluator(loop.body);
+                body(move(elem));
             }
 
             return Unit{};
@@ -287,6 +452,16 @@ namespace ejdi::exec {
             return arr;
         }
 
+        Value ev(const ObjectLiteral& lit) {
+            auto obj = make_shared<Object>(ctx.global.core->get(SYMBOL("Object")).as<Object>());
+            obj->fields.reserve(lit.fields->list.size());
+            for (const auto& field : lit.fields->list) {
+                obj->set_no_prototype(field.name.symbol, eval(ctx, field.value));
+            }
+
+            return obj;
+        }
+
         Value ev(const FunctionLiteral& lit) {
             return Function::lang(LangFunction(lit.argnames, lit.body));
         }
@@ -0,0 +1,101 @@
+#include <charconv>
+#include <cmath>
+#include <algorithm>
+
+#include <exec/format.hpp>
+
+using namespace std;
+using namespace ejdi::exec::value;
+using namespace ejdi::exec::context;
+
+using Ctx = Context&;
+
+namespace ejdi::exec::format {
+    static constexpr size_t CHUNK = 1 << 16;
+
+    void number(string& out, float x) {
+        // the sign of a NaN depends on how it was made (0/0 is negative on
+        // x86), so it isn't shown
+        if (isnan(x)) {
+            out += "nan";
+            return;
+        }
+
+        char buffer[64];
+        // std::to_chars without a precision is the shortest round trip
+        // (Ryu in libstdc++); fixed notation keeps integers readable
+        auto res = (x != 0 && fabs(x) < 1e-6f)
+            ? to_chars(begin(buffer), end(buffer), x)
+            : to_chars(begin(buffer), end(buffer), x, chars_format::fixed);
+        out.append(buffer, res.ptr);
+    }
+
+    string number(float x) {
+        string res;
+        number(res, x);
+        return res;
+    }
+
+    void Writer::spill() {
+        if (sink != nullptr && text_.size() >= CHUNK) {
+            sink->write(text_);
+            text_.clear();
+        }
+    }
+
+    void Writer::write(string_view str) {
+        text_ += str;
+        spill();
+    }
+
+    // Whether val's to_s is still the one its core prototype started with.
+    static bool builtin_to_s(Ctx ctx, Value& val) {
+        auto& to_s = lookup(ctx, val, SYMBOL("to_s"));
+        if (!to_s.is<Function>()) {
+            return false;
+        }
+
+        auto& builtins = ctx.global.builtin_to_s;
+        return find(builtins.begin(), builtins.end(), to_s.as<Function>()) != builtins.end();
+    }
+
+    void Writer::value(Ctx ctx, Value& val) {
+        if (val.is<Object>() || val.is<Function>() || val.is<Native>() || !builtin_to_s(ctx, val)) {
+            text_ += *lookupf(ctx, val, SYMBOL("to_s"))->call(ctx, { val }).as<string>();
+        } else if (val.is<float>()) {
+            number(text_, val.as<float>());
+        } else if (val.is<string>()) {
+            text_ += *val.as<string>();
+        } else if (val.is<bool>()) {
+            text_ += val.as<bool>() ? "true" : "false";
+        } else if (val.is<Unit>()) {
+            text_ += "()";
+        } else if (val.is<Array>()) {
+            // held, so a to_s method emptying the array can't free it
+            auto arr = val.as<Array>();
+            text_ += '[';
+            for (size_t i = 0; i < arr->size(); i++) {
+                if (i != 0) {
+                    text_ += ", ";
+                }
+                auto elem = (*arr)[i];
+                value(ctx, elem);
+            }
+            text_ += ']';
+        }
+        spill();
+    }
+
+    void Writer::finish() {
+        if (sink != nullptr && !text_.empty()) {
+            sink->write(text_);
+            text_.clear();
+        }
+    }
+
+    string to_s(Ctx ctx, Value& val) {
+        auto writer = Writer();
+        writer.value(ctx, val);
+        return move(writer.text());
+    }
+}
@@ -0,0 +1,485 @@
+#include <cerrno>
+#include <cstring>
+#include <limits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <exec/fs.hpp>
+#include <exec/isolate.hpp>
+#include <exec/iterator.hpp>
+#include <exec/strings.hpp>
+
+using namespace std;
+using namespace ejdi::exec::value;
+using namespace ejdi::exec::context;
+
+using Ctx = Context&;
+
+namespace ejdi::exec::fs {
+    static error::RuntimeError os_error(Ctx ctx, string what) {
+        what += ": ";
+        what += strerror(errno);
+        return ctx.error(move(what));
+    }
+
+    File::File(int fd, bool owned, bool readable, bool writable)
+        : fd(fd)
+        , owned(owned)
+        , readable(readable)
+    {
+        if (writable) {
+            sink = make_unique<output::Sink>(fd);
+        }
+    }
+
+    File::~File() {
+        release();
+    }
+
+    bool File::is_open() const {
+        auto lock = lock_guard(mutex);
+        return fd >= 0;
+    }
+
+    int File::release() {
+        auto lock = lock_guard(mutex);
+        if (fd < 0) {
+            return 0;
+        }
+
+        int error = 0;
+        if (sink != nullptr) {
+            sink->flush();
+            error = sink->take_error();
+            sink.reset();
+        }
+        if (owned && ::close(fd) < 0 && error == 0) {
+            error = errno;
+        }
+        fd = -1;
+        buffer = {};
+        start = end = 0;
+
+        return error;
+    }
+
+    void File::close(Ctx ctx) {
+        auto error = release();
+        if (error != 0) {
+            errno = error;
+            throw os_error(ctx, "can't write file");
+        }
+    }
+
+    // Raises the error of a buffered write that failed since the last check.
+    void File::check_written(Ctx ctx) {
+        auto error = sink->take_error();
+        if (error != 0) {
+            errno = error;
+            throw os_error(ctx, "can't write file");
+        }
+    }
+
+    void File::check_open(Ctx ctx) const {
+        if (fd < 0) {
+            throw ctx.error("file is closed");
+        }
+    }
+
+    // Refills the buffer once it has been used up. Returns false at the
+    // end of the file.
+    bool File::fill(Ctx ctx) {
+        check_open(ctx);
+        if (!readable) {
+            throw ctx.error("file is not open for reading");
+        } else if (at_eof) {
+            return false;
+        }
+
+        if (buffer.empty()) {
+            buffer.resize(BUFFER_SIZE);
+        }
+        start = end = 0;
+
+        while (true) {
+            auto got = ::read(fd, buffer.data(), buffer.size());
+            if (got < 0 && errno == EINTR) {
+                continue;
+            } else if (got < 0) {
+                throw os_error(ctx, "can't read file");
+            } else if (got == 0) {
+                at_eof = true;
+                return false;
+            }
+
+            end = got;
+            return true;
+        }
+    }
+
+    string File::read(Ctx ctx, size_t size) {
+        auto lock = lock_guard(mutex);
+        string res;
+        while (res.size() < size) {
+            if (start == end && !fill(ctx)) {
+                break;
+            }
+
+            auto n = min(size - res.size(), end - start);
+            res.append(buffer.data() + start, n);
+            start += n;
+        }
+        return res;
+    }
+
+    string File::read_all(Ctx ctx) {
+        auto lock = lock_guard(mutex);
+        string res;
+        do {
+            res.append(buffer.data() + start, end - start);
+            start = end;
+        } while (fill(ctx));
+        return res;
+    }
+
+    optional<string> File::read_line(Ctx ctx) {
+        auto lock = lock_guard(mutex);
+        string line;
+        while (true) {
+            if (start == end && !fill(ctx)) {
+                if (line.empty()) {
+                    return nullopt;
+                }
+                break;
+            }
+
+            auto* from = buffer.data() + start;
+            auto* newline = static_cast<char*>(memchr(from, '\n', end - start));
+            if (newline == nullptr) {
+                line.append(from, end - start);
+                start = end;
+                continue;
+            }
+
+            line.append(from, newline);
+            start = newline + 1 - buffer.data();
+            break;
+        }
+
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        return line;
+    }
+
+    void File::write(Ctx ctx, string_view str) {
+        auto lock = lock_guard(mutex);
+        check_open(ctx);
+        if (sink == nullptr) {
+            throw ctx.error("file is not open for writing");
+        }
+        sink->write(str);
+        check_written(ctx);
+    }
+
+    void File::flush(Ctx ctx) {
+        auto lock = lock_guard(mutex);
+        check_open(ctx);
+        if (sink != nullptr) {
+            sink->flush();
+            check_written(ctx);
+        }
+    }
+
+    string_view File::type_name() const {
+        return NAME;
+    }
+
+    string_view File::vtable_name() const {
+        return "File";
+    }
+
+
+    static Value lines(shared_ptr<File> file) {
+        return iterator::make(
+            [file](Ctx ctx) -> optional<Value> {
+                auto line = file->read_line(ctx);
+                if (!line.has_value()) {
+                    return nullopt;
+                }
+                return Value(move(*line));
+            });
+    }
+
+    Value file_prototype() {
+        auto obj = make_shared<Object>();
+        obj->set("to_s",
+                 Function::native_expanded<File>(
+                     [](Ctx, auto file) {
+                         return string(file->is_open() ? "[file]" : "[closed file]");
+                     })
+            );
+        obj->set("read",
+                 Function::native_expanded<File, float>(
+                     [](Ctx ctx, auto file, float size) {
+                         return file->read(ctx, to_index(ctx, size, numeric_limits<size_t>::max(), "invalid read size"));
+                     })
+            );
+        obj->set("read_all",
+                 Function::native_expanded<File>(
+                     [](Ctx ctx, auto file) {
+                         return file->read_all(ctx);
+                     })
+            );
+        obj->set("read_line",
+                 Function::native_expanded<File>(
+                     [](Ctx ctx, auto file) -> Value {
+                         auto line = file->read_line(ctx);
+                         if (!line.has_value()) {
+                             return Unit{};
+                         }
+                         return move(*line);
+                     })
+            );
+        obj->set("lines",
+                 Function::native_expanded<File>(
+                     [](Ctx, auto file) {
+                         return lines(move(file));
+                     })
+            );
+        obj->set("__iter",
+                 Function::native_expanded<File>(
+                     [](Ctx, auto file) {
+                         return lines(move(file));
+                     })
+            );
+        obj->set("write",
+                 Function::native(
+                     [](Ctx ctx, vector<Value> args) -> Value {
+                         if (args.size() < 1) {
+                             throw ctx.arg_count_error(1, args.size());
+                         }
+
+                         auto file = args[0].as<File>();
+                         for (size_t i = 1; i < args.size(); i++) {
+                             file->write(ctx, *args[i].as<string>());
+                         }
+                         return Unit{};
+                     })
+            );
+        obj->set("flush",
+                 Function::native_expanded<File>(
+                     [](Ctx ctx, auto file) {
+                         file->flush(ctx);
+                         return Unit{};
+                     })
+            );
+        obj->set("close",
+                 Function::native_expanded<File>(
+                     [](Ctx ctx, auto file) {
+                         file->close(ctx);
+                         return Unit{};
+                     })
+            );
+
+        return obj;
+    }
+
+    Mapping::Mapping(Ctx ctx, const string& path) {
+        auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw os_error(ctx, "can't open '" + path + "'");
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) < 0) {
+            auto error = os_error(ctx, "can't map '" + path + "'");
+            ::close(fd);
+            throw error;
+        }
+
+        // mmap can't map nothing, and an empty file needs no pages
+        size = info.st_size;
+        if (size > 0) {
+            auto* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                auto error = os_error(ctx, "can't map '" + path + "'");
+                ::close(fd);
+                throw error;
+            }
+            madvise(mapped, size, MADV_SEQUENTIAL);
+            data = static_cast<const char*>(mapped);
+        }
+        ::close(fd);
+    }
+
+    Mapping::~Mapping() {
+        if (data != nullptr) {
+            munmap(const_cast<char*>(data), size);
+        }
+    }
+
+    string_view Mapping::type_name() const {
+        return NAME;
+    }
+
+    string_view Mapping::vtable_name() const {
+        return "Mapping";
+    }
+
+    static Value position(size_t pos) {
+        return pos == string_view::npos ? Value(Unit{}) : Value(float(pos));
+    }
+
+    Value mapping_prototype() {
+        auto obj = make_shared<Object>();
+        obj->set("to_s",
+                 Function::native_expanded<Mapping>(
+                     [](Ctx, auto map) {
+                         return string(map->view());
+                     })
+            );
+        obj->set("len",
+                 Function::native_expanded<Mapping>(
+                     [](Ctx, auto map) {
+                         return float(map->view().size());
+                     })
+            );
+        obj->set("at",
+                 Function::native_expanded<Mapping, float>(
+                     [](Ctx ctx, auto map, float index) {
+                         auto str = map->view();
+                         return char_string(str[to_index(ctx, index, str.size(), "string index out of range")]);
+                     })
+            );
+        obj->set("slice",
+                 Function::native_expanded<Mapping, float, float>(
+                     [](Ctx ctx, auto map, float start_, float end_) {
+                         auto str = map->view();
+                         auto end = to_index(ctx, end_, str.size() + 1, "string index out of range");
+                         auto start = to_index(ctx, start_, end + 1, "start index is higher than end index");
+                         return string(str.substr(start, end - start));
+                     })
+            );
+        obj->set("find",
+                 Function::native_expanded<Mapping, string>(
+                     [](Ctx, auto map, auto needle) {
+                         return position(strings::find(map->view(), *needle));
+                     })
+            );
+        obj->set("rfind",
+                 Function::native_expanded<Mapping, string>(
+                     [](Ctx, auto map, auto needle) {
+                         return position(strings::rfind(map->view(), *needle));
+                     })
+            );
+        obj->set("contains",
+                 Function::native_expanded<Mapping, string>(
+                     [](Ctx, auto map, auto needle) {
+                         return strings::find(map->view(), *needle) != string_view::npos;
+                     })
+            );
+        obj->set("split",
+                 Function::native_expanded<Mapping, string>(
+                     [](Ctx ctx, auto map, auto sep) {
+                         if (sep->empty()) {
+                             throw ctx.error("separator can't be empty");
+                         }
+                         return strings::split(map->view(), *sep);
+                     })
+            );
+        // lazily, unlike String.lines, since mappings are usually large
+        obj->set("lines",
+                 Function::native_expanded<Mapping>(
+                     [](Ctx, auto map) {
+                         return iterator::make(
+                             [map, start = size_t(0)](Ctx) mutable -> optional<Value> {
+                                 auto str = map->view();
+                                 if (start >= str.size()) {
+                                     return nullopt;
+                                 }
+
+                                 auto end = strings::find(str, "\n", start);
+                                 if (end == string_view::npos) {
+                                     end = str.size();
+                                 }
+                                 auto line = str.substr(start, end - start);
+                                 if (!line.empty() && line.back() == '\r') {
+                                     line.remove_suffix(1);
+                                 }
+                                 start = end + 1;
+                                 return Value(string(line));
+                             });
+                     })
+            );
+
+        return obj;
+    }
+
+    static shared_ptr<File> open(Ctx ctx, const string& path, const string& mode) {
+        int flags;
+        if (mode == "r") {
+            flags = O_RDONLY;
+        } else if (mode == "w") {
+            flags = O_WRONLY | O_CREAT | O_TRUNC;
+        } else if (mode == "a") {
+            flags = O_WRONLY | O_CREAT | O_APPEND;
+        } else {
+            throw ctx.error("file mode must be \"r\", \"w\" or \"a\"");
+        }
+
+        auto fd = ::open(path.c_str(), flags | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw os_error(ctx, "can't open '" + path + "'");
+        }
+        return make_shared<File>(fd, true, mode == "r", mode != "r");
+    }
+
+    // Called as fs.open(...) and so on, so the functions get the module
+    // itself as their first argument.
+    Value module(GlobalContext& global) {
+        auto obj = make_shared<Object>();
+        obj->prototype = global.core->get("Object").as<Object>();
+
+        obj->set("open",
+                 Function::native(
+                     [](Ctx ctx, vector<Value> args) -> Value {
+                         if (args.size() < 2 || args.size() > 3) {
+                             throw ctx.arg_count_error(2, args.size());
+                         }
+
+                         auto mode = args.size() > 2 ? *args[2].as<string>() : string("r");
+                         return open(ctx, *args[1].as<string>(), mode);
+                     })
+            );
+        obj->set("read_all",
+                 Function::native_expanded<Object, string>(
+                     [](Ctx ctx, auto, auto path) {
+                         return open(ctx, *path, "r")->read_all(ctx);
+                     })
+            );
+        obj->set("write_all",
+                 Function::native_expanded<Object, string, string>(
+                     [](Ctx ctx, auto, auto path, auto str) {
+                         auto file = open(ctx, *path, "w");
+                         file->write(ctx, *str);
+                         file->close(ctx);
+                         return Unit{};
+                     })
+            );
+
+        obj->set("map",
+                 Function::native_expanded<Object, string>(
+                     [](Ctx ctx, auto, auto path) {
+                         return make_shared<Mapping>(ctx, *path);
+                     })
+            );
+
+        obj->set("stdin", global.shared->in);
+
+        return obj;
+    }
+}
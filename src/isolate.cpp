@@ -0,0 +1,257 @@
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <algorithm>
+
+#include <exec/isolate.hpp>
+#include <exec/context.hpp>
+#include <exec/channel.hpp>
+#include <exec/scheduler.hpp>
+#include <exec/fs.hpp>
+#include <lexer.hpp>
+#include <lexem_groups.hpp>
+#include <parser.hpp>
+
+using namespace std;
+using namespace ejdi::exec::value;
+using namespace ejdi::exec::context;
+using namespace ejdi::exec::error;
+
+namespace ejdi::exec::isolate {
+    Shared::Shared()
+        : in(make_shared<fs::File>(0, false, true, false)) {}
+    Shared::~Shared() = default;
+
+    shared_ptr<const Source> Shared::load_source(const filesystem::path& path) {
+        string key = path;
+
+        {
+            auto lock = lock_guard(sources_mutex);
+            auto iter = sources.find(key);
+            if (iter != sources.end() && iter->second->program != nullptr) {
+                return iter->second;
+            }
+        }
+
+        // parsing happens outside the lock; if two isolates race on the same
+        // module, both parse it and the last one to finish is kept
+        auto file = ifstream(path);
+        auto source = make_shared<Source>(string { istreambuf_iterator<char>(file), {} });
+
+        auto publish = [&]() {
+            auto lock = lock_guard(sources_mutex);
+            sources.insert_or_assign(key, source);
+        };
+
+        try {
+            auto lexems = lexer::actions::split_string(source->text, key);
+            auto group = lexer::groups::find_groups(move(lexems));
+            auto program = parser::parse_program(*group);
+            if (!program.has_result()) {
+                throw move(program.error());
+            }
+            source->program = program.get();
+        } catch (...) {
+            publish();
+            throw;
+        }
+
+        publish();
+        return source;
+    }
+
+    shared_ptr<const Source> Shared::find_source(const string& path) const {
+        auto lock = lock_guard(sources_mutex);
+        auto iter = sources.find(path);
+        if (iter != sources.end()) {
+            return iter->second;
+        } else {
+            return nullptr;
+        }
+    }
+
+    shared_ptr<channel::Channel> Shared::named_channel(const string& name, size_t capacity) {
+        auto lock = lock_guard(channels_mutex);
+        auto iter = channels.find(name);
+        if (iter != channels.end()) {
+            return iter->second;
+        }
+
+        auto chan = make_shared<channel::Channel>(capacity);
+        channels.emplace(name, chan);
+        return chan;
+    }
+
+    scheduler::Scheduler& Shared::scheduler() {
+        auto lock = lock_guard(scheduler_mutex);
+        if (scheduler_ == nullptr) {
+            auto threads = worker_count;
+            if (threads == 0) {
+                threads = max(thread::hardware_concurrency(), 1u);
+            }
+            scheduler_ = make_unique<scheduler::Scheduler>(*this, threads);
+        }
+
+        return *scheduler_;
+    }
+
+
+    struct Detacher {
+        Context& ctx;
+        shared_ptr<Object> object_prototype;
+        vector<shared_ptr<Object>> relink;
+        unordered_map<const void*, Value> copied;
+
+        static bool is_plain(Value& value) {
+            return value.is<Unit>() || value.is<float>() || value.is<bool>();
+        }
+
+        // `owned` is only set for the root: anything nested is still
+        // referenced by its container in the sender's heap.
+        Value detach(Value& value, bool owned = false) {
+            if (is_plain(value) || value.is<Function>()) {
+                // functions hold nothing but immutable AST or native code
+                return value;
+            } else if (value.is<string>()) {
+                auto& str = value.as<string>();
+                if (owned && str.use_count() == 1) {
+                    return move(str);
+                } else {
+                    return make_shared<string>(*str);
+                }
+            } else if (value.is<Array>()) {
+                return detach_array(value.as<Array>(), owned);
+            } else if (value.is<Object>()) {
+                return detach_object(value.as<Object>());
+            } else {
+                auto& native = value.as<Native>();
+                auto transferred = native->transfer(native, [this](Value& nested) { return detach(nested); });
+                if (transferred == nullptr) {
+                    string msg = "a ";
+                    msg += native->type_name();
+                    msg += " can't be sent to another isolate";
+                    throw ctx.error(move(msg));
+                }
+                return transferred;
+            }
+        }
+
+        Value detach_array(shared_ptr<Array>& arr, bool owned) {
+            if (arr->frozen) {
+                return arr;
+            }
+
+            if (all_of(arr->begin(), arr->end(), is_plain)) {
+                if (owned && arr.use_count() == 1) {
+                    return move(arr);
+                } else {
+                    return make_shared<Array>(*arr);
+                }
+            }
+
+            auto iter = copied.find(arr.get());
+            if (iter != copied.end()) {
+                return iter->second;
+            }
+
+            auto copy = make_shared<Array>();
+            copied.emplace(arr.get(), copy);
+
+            copy->reserve(arr->size());
+            for (auto& elem : *arr) {
+                copy->push_back(detach(elem));
+            }
+
+            return copy;
+        }
+
+        Value detach_object(shared_ptr<Object>& obj) {
+            if (obj->frozen) {
+                return obj;
+            }
+
+            auto iter = copied.find(obj.get());
+            if (iter != copied.end()) {
+                return iter->second;
+            }
+
+            auto copy = make_shared<Object>();
+            copied.emplace(obj.get(), copy);
+
+            copy->mutable_prototype_fields = obj->mutable_prototype_fields;
+            // same names (interned or not) and layout, then the values are
+            // replaced by their copies
+            copy->fields = obj->fields;
+            for (size_t i = 0; i < obj->fields.size(); i++) {
+                copy->fields.value(i) = detach(obj->fields.value(i));
+            }
+
+            if (obj->prototype == object_prototype) {
+                relink.push_back(copy);
+            } else if (obj->prototype != nullptr) {
+                Value proto = obj->prototype;
+                copy->prototype = detach(proto).as<Object>();
+            }
+
+            return copy;
+        }
+    };
+
+    Message detach(Context& ctx, Value value) {
+        auto detacher = Detacher { ctx, ctx.global.core->get("Object").as<Object>() };
+        auto detached = detacher.detach(value, true);
+        return Message { move(detached), move(detacher.relink) };
+    }
+
+    Value attach(Context& ctx, Message message) {
+        auto object_prototype = ctx.global.core->get("Object").as<Object>();
+        for (auto& obj : message.relink) {
+            obj->prototype = object_prototype;
+        }
+
+        return move(message.value);
+    }
+
+
+    static bool run_one(shared_ptr<Shared> shared, const string& module, size_t id, size_t count) {
+        auto global = GlobalContext::with_core(move(shared));
+        global.line_serialized_output = true;
+
+        auto isolate = global.core->get("prelude").as<Object>()->get("isolate").as<Object>();
+        isolate->set("id", (float)id);
+        isolate->set("count", (float)count);
+
+        bool ok = true;
+        try {
+            global.load_module(module);
+        } catch (RuntimeError& e) {
+            global.print_error_message(e);
+            ok = false;
+        }
+
+        global.close_output();
+        return ok;
+    }
+
+    size_t run(shared_ptr<Shared> shared, string module, size_t count) {
+        vector<thread> threads;
+        vector<char> ok(count, false);
+
+        threads.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            threads.emplace_back([&, i]() {
+                ok[i] = run_one(shared, module, i, count);
+            });
+        }
+
+        size_t failed = 0;
+        for (size_t i = 0; i < count; i++) {
+            threads[i].join();
+            if (!ok[i]) {
+                failed += 1;
+            }
+        }
+
+        return failed;
+    }
+}
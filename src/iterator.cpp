@@ -0,0 +1,295 @@
+#include <cmath>
+#include <limits>
+
+#include <exec/iterator.hpp>
+#include <exec/format.hpp>
+#include <exec/context.hpp>
+
+using namespace std;
+using namespace ejdi::exec::value;
+using namespace ejdi::exec::context;
+
+using Ctx = Context&;
+
+namespace ejdi::exec::iterator {
+    string_view NativeIterator::type_name() const {
+        return NAME;
+    }
+
+    string_view NativeIterator::vtable_name() const {
+        return "Iterator";
+    }
+
+    // Far more steps than any loop runs, and small enough that the count
+    // converts exactly.
+    static constexpr float MAX_RANGE_LENGTH = float(uint64_t(1) << 48);
+
+    Range::Range(float start, float stop, float step, size_t count)
+        : start(start)
+        , stop(stop)
+        , step(step)
+        , count(count) {}
+
+    // computed from the index, so long ranges don't accumulate rounding
+    float Range::at(size_t i) const {
+        return start + step * i;
+    }
+
+    string_view Range::type_name() const {
+        return NAME;
+    }
+
+    string_view Range::vtable_name() const {
+        return "Range";
+    }
+
+    shared_ptr<Native> Range::transfer(const shared_ptr<Native>& self, const CopyValue&) const {
+        return self;
+    }
+
+    bool Range::shareable() const {
+        return true;
+    }
+
+    Value range(Ctx ctx, vector<Value> args) {
+        if (args.empty()) {
+            throw ctx.arg_count_error(1, 0);
+        } else if (args.size() > 3) {
+            throw ctx.arg_count_error(3, args.size());
+        }
+
+        float start = 0;
+        float stop;
+        float step = 1;
+        if (args.size() == 1) {
+            stop = args[0].as<float>();
+        } else {
+            start = args[0].as<float>();
+            stop = args[1].as<float>();
+        }
+        if (args.size() > 2) {
+            step = args[2].as<float>();
+        }
+
+        if (step == 0) {
+            throw ctx.error("range step can't be zero");
+        } else if (!isfinite(start) || !isfinite(stop) || !isfinite(step)) {
+            throw ctx.error("range bounds and step must be finite");
+        }
+
+        size_t count = 0;
+        auto steps = ceil((stop - start) / step);
+        if (steps > 0) {
+            count = to_index(ctx, steps, size_t(MAX_RANGE_LENGTH) + 1, "range is too long");
+        }
+
+        return make_shared<Range>(start, stop, step, count);
+    }
+
+    Value range_prototype() {
+        auto obj = make_shared<Object>();
+        obj->set("to_s",
+                 Function::native_expanded<Range>(
+                     [](Ctx, auto range) {
+                         using format::number;
+                         return "range(" + number(range->start) + ", " + number(range->stop) + ", " + number(range->step) + ")";
+                     })
+            );
+        obj->set("len",
+                 Function::native_expanded<Range>(
+                     [](Ctx, auto range) {
+                         return (float)range->count;
+                     })
+            );
+        obj->set("__iter",
+                 Function::native_expanded<Range>(
+                     [](Ctx, auto range) {
+                         return make(
+                             [range, i = size_t(0)](Ctx) mutable -> optional<Value> {
+                                 if (i < range->count) {
+                                     return Value(range->at(i++));
+                                 } else {
+                                     return nullopt;
+                                 }
+                             });
+                     })
+            );
+
+        return obj;
+    }
+
+    shared_ptr<NativeIterator> from(Ctx ctx, Value iterable) {
+        if (iterable.is<NativeIterator>()) {
+            return iterable.as<NativeIterator>();
+        }
+
+        auto iter = lookupf(ctx, iterable, SYMBOL("__iter"))->call(ctx, { iterable });
+        if (iter.is<NativeIterator>()) {
+            return iter.as<NativeIterator>();
+        }
+
+        auto end = ctx.global.core->get(SYMBOL("Iterator")).as<Object>()->get(SYMBOL("end")).as<Object>();
+        return make_shared<NativeIterator>(
+            [iter, end](Ctx ctx) mutable -> optional<Value> {
+                auto elem = lookupf(ctx, iter, SYMBOL("__next"))->call(ctx, { iter });
+                if (elem.is<Object>() && elem.as<Object>() == end) {
+                    return nullopt;
+                }
+                return elem;
+            });
+    }
+
+    static size_t count_arg(Ctx ctx, float n) {
+        return to_index(ctx, n, numeric_limits<size_t>::max(), "invalid count");
+    }
+
+    Value prototype() {
+        auto obj = make_shared<Object>();
+        obj->set("end", make_shared<Object>());
+        obj->set("map",
+                 Function::native_expanded<NativeIterator, Function>(
+                     [](Ctx, auto src, auto func) {
+                         return make(
+                             [src, func](Ctx ctx) -> optional<Value> {
+                                 auto elem = src->next(ctx);
+                                 if (!elem.has_value()) {
+                                     return nullopt;
+                                 }
+                                 return func->call(ctx, { move(*elem) });
+                             });
+                     })
+            );
+        obj->set("filter",
+                 Function::native_expanded<NativeIterator, Function>(
+                     [](Ctx, auto src, auto func) {
+                         return make(
+                             [src, func](Ctx ctx) -> optional<Value> {
+                                 while (auto elem = src->next(ctx)) {
+                                     if (func->call(ctx, { *elem }).template as<bool>()) {
+                                         return elem;
+                                     }
+                                 }
+                                 return nullopt;
+                             });
+                     })
+            );
+        obj->set("take",
+                 Function::native_expanded<NativeIterator, float>(
+                     [](Ctx ctx, auto src, float n) {
+                         return make(
+                             [src, left = count_arg(ctx, n)](Ctx ctx) mutable -> optional<Value> {
+                                 if (left == 0) {
+                                     return nullopt;
+                                 }
+                                 left--;
+                                 return src->next(ctx);
+                             });
+                     })
+            );
+        obj->set("skip",
+                 Function::native_expanded<NativeIterator, float>(
+                     [](Ctx ctx, auto src, float n) {
+                         return make(
+                             [src, skip = count_arg(ctx, n)](Ctx ctx) mutable -> optional<Value> {
+                                 for (; skip > 0; skip--) {
+                                     if (!src->next(ctx).has_value()) {
+                                         return nullopt;
+                                     }
+                                 }
+                                 return src->next(ctx);
+                             });
+                     })
+            );
+        obj->set("zip",
+                 Function::native_expanded<NativeIterator, Value>(
+                     [](Ctx ctx, auto src, Value other) {
+                         return make(
+                             [src, other = from(ctx, move(other))](Ctx ctx) -> optional<Value> {
+                                 auto a = src->next(ctx);
+                                 if (!a.has_value()) {
+                                     return nullopt;
+                                 }
+                                 auto b = other->next(ctx);
+                                 if (!b.has_value()) {
+                                     return nullopt;
+                                 }
+                                 return Value(make_shared<Array>(Array { move(*a), move(*b) }));
+                             });
+                     })
+            );
+        obj->set("enumerate",
+                 Function::native_expanded<NativeIterator>(
+                     [](Ctx, auto src) {
+                         return make(
+                             [src, i = 0.0f](Ctx ctx) mutable -> optional<Value> {
+                                 auto elem = src->next(ctx);
+                                 if (!elem.has_value()) {
+                                     return nullopt;
+                                 }
+                                 return Value(make_shared<Array>(Array { i++, move(*elem) }));
+                             });
+                     })
+            );
+        obj->set("chunk",
+                 Function::native_expanded<NativeIterator, float>(
+                     [](Ctx ctx, auto src, float n) {
+                         auto size = count_arg(ctx, n);
+                         if (size == 0) {
+                             throw ctx.error("chunk size must be at least 1");
+                         }
+
+                         return make(
+                             [src, size](Ctx ctx) -> optional<Value> {
+                                 auto chunk = make_shared<Array>();
+                                 while (chunk->size() < size) {
+                                     auto elem = src->next(ctx);
+                                     if (!elem.has_value()) {
+                                         break;
+                                     }
+                                     chunk->push_back(move(*elem));
+                                 }
+
+                                 if (chunk->empty()) {
+                                     return nullopt;
+                                 }
+                                 return Value(move(chunk));
+                             });
+                     })
+            );
+        obj->set("collect",
+                 Function::native_expanded<NativeIterator>(
+                     [](Ctx ctx, auto src) {
+                         auto res = make_shared<Array>();
+                         while (auto elem = src->next(ctx)) {
+                             res->push_back(move(*elem));
+                         }
+                         return res;
+                     })
+            );
+        obj->set("to_s",
+                 Function::native_expanded(
+                     [](Ctx) {
+                         return string("[iterator]");
+                     })
+            );
+        obj->set("__iter",
+                 Function::native_expanded<NativeIterator>(
+                     [](Ctx, auto iter) {
+                         return iter;
+                     })
+            );
+        obj->set("__next",
+                 Function::native_expanded<NativeIterator>(
+                     [](Ctx ctx, auto iter) {
+                         auto elem = iter->next(ctx);
+                         if (elem.has_value()) {
+                             return move(*elem);
+                         } else {
+                             return ctx.global.core->get(SYMBOL("Iterator")).template as<Object>()->get(SYMBOL("end"));
+                         }
+                     })
+            );
+
+        return obj;
+    }
+}
@@ -0,0 +1,650 @@
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include <exec/json.hpp>
+#include <exec/format.hpp>
+#include <exec/iterator.hpp>
+#include <symbol.hpp>
+
+using namespace std;
+using namespace ejdi::exec::value;
+using namespace ejdi::exec::context;
+
+using Ctx = Context&;
+
+namespace ejdi::exec::json {
+    static constexpr size_t MAX_DEPTH = 1024;
+
+    [[noreturn]] static void fail(Ctx ctx, size_t pos, const char* why) {
+        string msg = "invalid JSON at byte ";
+        msg += to_string(pos);
+        msg += ": ";
+        msg += why;
+        throw ctx.error(move(msg));
+    }
+
+
+    // Stage 1
+
+    struct Masks {
+        uint64_t quote = 0;
+        uint64_t backslash = 0;
+        // { } [ ] : ,
+        uint64_t op = 0;
+        uint64_t space = 0;
+    };
+
+    static Masks classify(const char* block) {
+        Masks masks;
+#if defined(__SSE2__)
+        for (int i = 0; i < 4; i++) {
+            auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i * 16));
+            auto eq = [&](char c) { return _mm_cmpeq_epi8(bytes, _mm_set1_epi8(c)); };
+            auto bits = [](__m128i mask) { return uint64_t(uint16_t(_mm_movemask_epi8(mask))); };
+
+            // setting bit 5 turns [ into { and ] into }, and keeps : and ,
+            auto folded = _mm_or_si128(bytes, _mm_set1_epi8(0x20));
+            auto eq_folded = [&](char c) { return _mm_cmpeq_epi8(folded, _mm_set1_epi8(c)); };
+
+            auto shift = i * 16;
+            masks.quote |= bits(eq('"')) << shift;
+            masks.backslash |= bits(eq('\\')) << shift;
+            masks.op |= bits(_mm_or_si128(
+                _mm_or_si128(eq_folded('{'), eq_folded('}')),
+                _mm_or_si128(eq(':'), eq(',')))) << shift;
+            masks.space |= bits(_mm_or_si128(
+                _mm_or_si128(eq(' '), eq('\t')),
+                _mm_or_si128(eq('\n'), eq('\r')))) << shift;
+        }
+#else
+        for (int i = 0; i < 64; i++) {
+            auto bit = uint64_t(1) << i;
+            switch (block[i]) {
+                case '"': masks.quote |= bit; break;
+                case '\\': masks.backslash |= bit; break;
+                case '{': case '}': case '[': case ']': case ':': case ',':
+                    masks.op |= bit;
+                    break;
+                case ' ': case '\t': case '\n': case '\r':
+                    masks.space |= bit;
+                    break;
+            }
+        }
+#endif
+        return masks;
+    }
+
+    // Bit i of the result is the xor of bits 0..i, so a mask of quotes
+    // becomes a mask of everything from an opening quote up to (not
+    // including) its closing quote.
+    static uint64_t prefix_xor(uint64_t x) {
+        x ^= x << 1;
+        x ^= x << 2;
+        x ^= x << 4;
+        x ^= x << 8;
+        x ^= x << 16;
+        x ^= x << 32;
+        return x;
+    }
+
+    // The position of every bracket, colon and comma, opening quote and
+    // first byte of a number or literal.
+    static vector<uint32_t> index_structurals(Ctx ctx, string_view text) {
+        if (text.size() > numeric_limits<uint32_t>::max()) {
+            throw ctx.error("JSON text is too large");
+        }
+
+        vector<uint32_t> positions;
+        positions.reserve(text.size() / 4 + 16);
+
+        uint64_t prev_in_string = 0;
+        uint64_t prev_escaped = 0;
+        uint64_t prev_scalar = 0;
+
+        for (size_t base = 0; base < text.size(); base += 64) {
+            const char* block = text.data() + base;
+            char tail[64];
+            if (text.size() - base < 64) {
+                memset(tail, ' ', sizeof(tail));
+                memcpy(tail, block, text.size() - base);
+                block = tail;
+            }
+            auto masks = classify(block);
+
+            // Backslashes are rare, so the escaped bytes are worked out one
+            // backslash at a time: each one that isn't escaped itself
+            // escapes the next byte.
+            uint64_t escaped = prev_escaped;
+            prev_escaped = 0;
+            for (auto rest = masks.backslash; rest != 0; rest &= rest - 1) {
+                auto bit = rest & -rest;
+                if (escaped & bit) {
+                    continue;
+                } else if (bit >> 63) {
+                    prev_escaped = 1;
+                } else {
+                    escaped |= bit << 1;
+                }
+            }
+
+            auto quotes = masks.quote & ~escaped;
+            auto in_string = prefix_xor(quotes) ^ prev_in_string;
+            prev_in_string = uint64_t(int64_t(in_string) >> 63);
+
+            auto scalar = ~(masks.op | masks.space | masks.quote) & ~in_string;
+            auto scalar_start = scalar & ~(scalar << 1 | prev_scalar);
+            prev_scalar = scalar >> 63;
+
+            auto structurals = (masks.op & ~in_string) | (quotes & in_string) | scalar_start;
+            for (; structurals != 0; structurals &= structurals - 1) {
+                positions.push_back(base + __builtin_ctzll(structurals));
+            }
+        }
+
+        if (prev_in_string) {
+            fail(ctx, text.size(), "unterminated string");
+        }
+        return positions;
+    }
+
+
+    // Stage 2
+
+    static void append_utf8(string& out, uint32_t code) {
+        if (code < 0x80) {
+            out += char(code);
+        } else if (code < 0x800) {
+            out += char(0xc0 | code >> 6);
+            out += char(0x80 | (code & 0x3f));
+        } else if (code < 0x10000) {
+            out += char(0xe0 | code >> 12);
+            out += char(0x80 | (code >> 6 & 0x3f));
+            out += char(0x80 | (code & 0x3f));
+        } else {
+            out += char(0xf0 | code >> 18);
+            out += char(0x80 | (code >> 12 & 0x3f));
+            out += char(0x80 | (code >> 6 & 0x3f));
+            out += char(0x80 | (code & 0x3f));
+        }
+    }
+
+    struct Parser {
+        Ctx ctx;
+        string_view text;
+        const vector<uint32_t>& positions;
+        size_t next = 0;
+        shared_ptr<Object> object_prototype;
+
+        size_t peek() {
+            if (next >= positions.size()) {
+                fail(ctx, text.size(), "unexpected end of input");
+            }
+            return positions[next];
+        }
+
+        void expect(char c, const char* why) {
+            auto pos = peek();
+            if (text[pos] != c) {
+                fail(ctx, pos, why);
+            }
+            next++;
+        }
+
+        Value value(size_t depth) {
+            if (depth > MAX_DEPTH) {
+                fail(ctx, peek(), "nested too deeply");
+            }
+
+            auto pos = peek();
+            next++;
+            switch (text[pos]) {
+                case '{': return object(depth);
+                case '[': return array(depth);
+                case '"': return string_at(pos);
+                default: return scalar(pos);
+            }
+        }
+
+        Value object(size_t depth) {
+            auto obj = make_shared<Object>(object_prototype);
+            if (text[peek()] == '}') {
+                next++;
+                return obj;
+            }
+
+            while (true) {
+                auto pos = peek();
+                if (text[pos] != '"') {
+                    fail(ctx, pos, "expected a string key");
+                }
+                next++;
+                string escaped;
+                auto name = key(pos, escaped);
+                expect(':', "expected ':'");
+                obj->fields.insert_or_assign(name, value(depth + 1));
+
+                pos = peek();
+                next++;
+                if (text[pos] == '}') {
+                    return obj;
+                } else if (text[pos] != ',') {
+                    fail(ctx, pos, "expected ',' or '}'");
+                }
+            }
+        }
+
+        Value array(size_t depth) {
+            auto arr = make_shared<Array>();
+            if (text[peek()] == ']') {
+                next++;
+                return arr;
+            }
+
+            while (true) {
+                arr->push_back(value(depth + 1));
+
+                auto pos = peek();
+                next++;
+                if (text[pos] == ']') {
+                    return arr;
+                } else if (text[pos] != ',') {
+                    fail(ctx, pos, "expected ',' or ']'");
+                }
+            }
+        }
+
+        // Finds the next quote or backslash 16 bytes at a time, and copies
+        // everything before it in one go.
+        size_t find_special(size_t pos) {
+#if defined(__SSE2__)
+            auto quote = _mm_set1_epi8('"');
+            auto backslash = _mm_set1_epi8('\\');
+            for (; pos + 16 <= text.size(); pos += 16) {
+                auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + pos));
+                auto mask = _mm_movemask_epi8(
+                    _mm_or_si128(_mm_cmpeq_epi8(bytes, quote), _mm_cmpeq_epi8(bytes, backslash)));
+                if (mask != 0) {
+                    return pos + __builtin_ctz(mask);
+                }
+            }
+#endif
+            for (; pos < text.size(); pos++) {
+                if (text[pos] == '"' || text[pos] == '\\') {
+                    return pos;
+                }
+            }
+            return pos;
+        }
+
+        uint32_t hex4(size_t pos) {
+            if (pos + 4 > text.size()) {
+                fail(ctx, pos, "truncated \\u escape");
+            }
+
+            uint32_t code;
+            auto res = from_chars(text.data() + pos, text.data() + pos + 4, code, 16);
+            if (res.ec != errc() || res.ptr != text.data() + pos + 4) {
+                fail(ctx, pos, "invalid \\u escape");
+            }
+            return code;
+        }
+
+        // `quote` is the position of the opening quote; stage 1 has made
+        // sure the string is terminated.
+        Value string_at(size_t quote) {
+            string out;
+            auto pos = quote + 1;
+            while (true) {
+                auto special = find_special(pos);
+                out.append(text.data() + pos, special - pos);
+                pos = special;
+
+                if (text[pos] == '"') {
+                    return move(out);
+                }
+
+                auto c = text[pos + 1];
+                pos += 2;
+                switch (c) {
+                    case '"': out += '"'; break;
+                    case '\\': out += '\\'; break;
+                    case '/': out += '/'; break;
+                    case 'b': out += '\b'; break;
+                    case 'f': out += '\f'; break;
+                    case 'n': out += '\n'; break;
+                    case 'r': out += '\r'; break;
+                    case 't': out += '\t'; break;
+                    case 'u': {
+                        auto code = hex4(pos);
+                        pos += 4;
+                        // a surrogate pair encodes one code point
+                        if (code >= 0xd800 && code < 0xdc00
+                            && text.substr(pos, 2) == "\\u") {
+                            auto low = hex4(pos + 2);
+                            if (low >= 0xdc00 && low < 0xe000) {
+                                code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                                pos += 6;
+                            }
+                        }
+                        // half a pair has no UTF-8 form
+                        if (code >= 0xd800 && code < 0xe000) {
+                            code = 0xfffd;
+                        }
+                        append_utf8(out, code);
+                        break;
+                    }
+                    default:
+                        fail(ctx, pos - 1, "invalid escape");
+                }
+            }
+        }
+
+        // Keys without escapes are read straight from the text, others are
+        // decoded into `escaped`. They aren't interned: a key the program
+        // never names stays a string on its object (see Fields).
+        string_view key(size_t quote, string& escaped) {
+            auto end = find_special(quote + 1);
+            if (text[end] == '"') {
+                return text.substr(quote + 1, end - quote - 1);
+            }
+            escaped = move(*string_at(quote).as<string>());
+            return escaped;
+        }
+
+        static bool is_digit(char c) {
+            return c >= '0' && c <= '9';
+        }
+
+        // -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+        size_t number_end(size_t pos) {
+            auto digits = [&](size_t at) {
+                auto from = at;
+                while (at < text.size() && is_digit(text[at])) {
+                    at++;
+                }
+                if (at == from) {
+                    fail(ctx, at, "expected a digit");
+                }
+                return at;
+            };
+
+            if (text[pos] == '-') {
+                pos++;
+            }
+            if (pos < text.size() && text[pos] == '0') {
+                pos++;
+            } else {
+                pos = digits(pos);
+            }
+            if (pos < text.size() && text[pos] == '.') {
+                pos = digits(pos + 1);
+            }
+            if (pos < text.size() && (text[pos] == 'e' || text[pos] == 'E')) {
+                pos++;
+                if (pos < text.size() && (text[pos] == '+' || text[pos] == '-')) {
+                    pos++;
+                }
+                pos = digits(pos);
+            }
+            return pos;
+        }
+
+        // The power of ten of the first significant digit of a number that
+        // passed number_end, which is all an out of range result needs to
+        // tell an overflow from an underflow. The exponent saturates.
+        static long long magnitude(string_view num) {
+            size_t i = num[0] == '-' ? 1 : 0;
+            long long mag = 0;
+            long long int_digits = 0;
+            for (; i < num.size() && is_digit(num[i]); i++) {
+                if (int_digits > 0 || num[i] != '0') {
+                    int_digits++;
+                }
+            }
+            if (int_digits > 0) {
+                mag = int_digits - 1;
+            } else if (i < num.size() && num[i] == '.') {
+                for (i++; i < num.size() && num[i] == '0'; i++) {
+                    mag--;
+                }
+                mag--;
+            }
+
+            while (i < num.size() && (is_digit(num[i]) || num[i] == '.')) {
+                i++;
+            }
+            if (i < num.size()) {
+                // e or E
+                i++;
+                bool negative = num[i] == '-';
+                if (num[i] == '-' || num[i] == '+') {
+                    i++;
+                }
+                long long exponent = 0;
+                for (; i < num.size() && exponent < 1'000'000'000; i++) {
+                    exponent = exponent * 10 + (num[i] - '0');
+                }
+                mag += negative ? -exponent : exponent;
+            }
+            return mag;
+        }
+
+        Value scalar(size_t pos) {
+            Value res = Unit{};
+            size_t end;
+
+            auto literal = [&](string_view word) {
+                if (text.substr(pos, word.size()) != word) {
+                    fail(ctx, pos, "unexpected character");
+                }
+                return pos + word.size();
+            };
+
+            switch (text[pos]) {
+                case 't': end = literal("true"); res = true; break;
+                case 'f': end = literal("false"); res = false; break;
+                case 'n': end = literal("null"); break;
+                default: {
+                    if (text[pos] != '-' && !is_digit(text[pos])) {
+                        fail(ctx, pos, "unexpected character");
+                    }
+
+                    end = number_end(pos);
+                    float num;
+                    auto parsed = from_chars(text.data() + pos, text.data() + end, num);
+                    if (parsed.ec == errc::result_out_of_range) {
+                        // too small rounds to 0, too large to infinity
+                        bool tiny = magnitude(text.substr(pos, end - pos)) < 0;
+                        num = tiny ? 0.0f : numeric_limits<float>::infinity();
+                        if (text[pos] == '-') {
+                            num = -num;
+                        }
+                    }
+                    res = num;
+                }
+            }
+
+            // the token has to end where the next one starts
+            if (end < text.size()
+                && (text[end] == '\0' || !strchr(" \t\n\r{}[]:,\"", text[end]))) {
+                fail(ctx, end, "unexpected character");
+            }
+            return res;
+        }
+    };
+
+    Value parse(Ctx ctx, string_view text) {
+        auto positions = index_structurals(ctx, text);
+        auto parser = Parser {
+            ctx, text, positions, 0,
+            ctx.global.core->get(SYMBOL("Object")).as<Object>()
+        };
+
+        auto res = parser.value(0);
+        if (parser.next != positions.size()) {
+            fail(ctx, positions[parser.next], "unexpected data after the value");
+        }
+        return res;
+    }
+
+
+    struct Stringifier {
+        Ctx ctx;
+        string out;
+
+        // Copies runs of bytes that need no escaping 16 at a time.
+        void write_string(string_view str) {
+            out += '"';
+            size_t pos = 0;
+            while (pos < str.size()) {
+                auto run = pos;
+#if defined(__SSE2__)
+                auto quote = _mm_set1_epi8('"');
+                auto backslash = _mm_set1_epi8('\\');
+                auto control = _mm_set1_epi8(0x1f);
+                for (; run + 16 <= str.size(); run += 16) {
+                    auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str.data() + run));
+                    // unsigned bytes <= 0x1f are the ones min() leaves alone
+                    auto special = _mm_or_si128(
+                        _mm_or_si128(_mm_cmpeq_epi8(bytes, quote), _mm_cmpeq_epi8(bytes, backslash)),
+                        _mm_cmpeq_epi8(_mm_min_epu8(bytes, control), bytes));
+                    auto mask = _mm_movemask_epi8(special);
+                    if (mask != 0) {
+                        run += __builtin_ctz(mask);
+                        break;
+                    }
+                }
+#endif
+                while (run < str.size() && str[run] != '"' && str[run] != '\\'
+                       && static_cast<unsigned char>(str[run]) >= 0x20) {
+                    run++;
+                }
+                out.append(str.data() + pos, run - pos);
+                pos = run;
+                if (pos == str.size()) {
+                    break;
+                }
+
+                auto c = str[pos++];
+                switch (c) {
+                    case '"': out += "\\\""; break;
+                    case '\\': out += "\\\\"; break;
+                    case '\n': out += "\\n"; break;
+                    case '\r': out += "\\r"; break;
+                    case '\t': out += "\\t"; break;
+                    case '\b': out += "\\b"; break;
+                    case '\f': out += "\\f"; break;
+                    default: {
+                        char escape[8];
+                        snprintf(escape, sizeof(escape), "\\u%04x", static_cast<unsigned char>(c));
+                        out += escape;
+                    }
+                }
+            }
+            out += '"';
+        }
+
+        void value(Value& val, size_t depth) {
+            if (depth > MAX_DEPTH) {
+                throw ctx.error("value is nested too deeply to convert to JSON (or contains itself)");
+            }
+
+            if (val.is<float>()) {
+                auto num = val.as<float>();
+                if (!isfinite(num)) {
+                    throw ctx.error("NaN and infinity can't be converted to JSON");
+                }
+                format::number(out, num);
+            } else if (val.is<string>()) {
+                write_string(*val.as<string>());
+            } else if (val.is<bool>()) {
+                out += val.as<bool>() ? "true" : "false";
+            } else if (val.is<Unit>() || val.is<Function>()) {
+                out += "null";
+            } else if (val.is<Array>()) {
+                auto arr = val.as<Array>();
+                out += '[';
+                for (size_t i = 0; i < arr->size(); i++) {
+                    if (i != 0) {
+                        out += ',';
+                    }
+                    auto elem = (*arr)[i];
+                    value(elem, depth + 1);
+                }
+                out += ']';
+            } else if (val.is<Object>()) {
+                auto obj = val.as<Object>();
+                out += '{';
+                bool first = true;
+                for (size_t i = 0; i < obj->fields.size(); i++) {
+                    auto field = obj->fields.value(i);
+                    if (field.is<Function>()) {
+                        continue;
+                    }
+                    if (!first) {
+                        out += ',';
+                    }
+                    first = false;
+
+                    write_string(obj->fields.name_string(i));
+                    out += ':';
+                    value(field, depth + 1);
+                }
+                out += '}';
+            } else {
+                string msg = "can't convert ";
+                msg += visit([](auto& arg){ return __type_name(&arg); }, val.value);
+                msg += " to JSON";
+                throw ctx.error(move(msg));
+            }
+        }
+    };
+
+    string stringify(Ctx ctx, Value& val) {
+        auto writer = Stringifier { ctx };
+        writer.value(val, 0);
+        return move(writer.out);
+    }
+
+    // Called as json.parse(...) and so on, so the functions get the json
+    // object itself as their first argument.
+    Value module(const shared_ptr<Object>& core) {
+        auto obj = make_shared<Object>();
+        obj->prototype = core->get("Object").as<Object>();
+
+        obj->set("parse",
+                 Function::native_expanded<Object, string>(
+                     [](Ctx ctx, auto, auto text) {
+                         return parse(ctx, *text);
+                     })
+            );
+        obj->set("stringify",
+                 Function::native_expanded<Object, Value>(
+                     [](Ctx ctx, auto, Value val) {
+                         return stringify(ctx, val);
+                     })
+            );
+        obj->set("lines",
+                 Function::native_expanded<Object, Value>(
+                     [](Ctx ctx, auto, Value source) {
+                         return iterator::make(
+                             [lines = iterator::from(ctx, move(source))](Ctx ctx) -> optional<Value> {
+                                 while (auto line = lines->next(ctx)) {
+                                     auto& text = *line->template as<string>();
+                                     if (text.find_first_not_of(" \t\r") != string::npos) {
+                                         return parse(ctx, text);
+                                     }
+                                 }
+                                 return nullopt;
+                             });
+                     })
+            );
+
+        return obj;
+    }
+}
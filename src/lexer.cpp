@@ -3,6 +3,7 @@
 #include <iostream>
 #include <optional>
 #include <functional>
+#include <limits>
 
 #include <span.hpp>
 #include <lexer.hpp>
@@ -39,8 +40,14 @@ string StringLit::value() const {
 }
 
 
-float NumberLit::value() const {
-    return stof(str);
+NumberLit::NumberLit(Span span, string_view str)
+    : LexemBase(span, string(str))
+{
+    // literals are just digits and a dot, so they only fail to parse when
+    // they're out of range: too large if a non-zero digit comes before the
+    // dot, too small otherwise
+    auto too_large = str.find_first_not_of("0.") < str.find('.');
+    val = parse_number(str).value_or(too_large ? numeric_limits<float>::infinity() : 0.0f);
 }
 
 
@@ -1,23 +1,73 @@
 #include <cassert>
+#include <charconv>
 #include <iostream>
 #include <fstream>
 #include <string>
 
 #include <exec/context.hpp>
+#include <exec/isolate.hpp>
 
 using namespace std;
 
+// Thread counts past this are surely a typo.
+static constexpr size_t MAX_THREADS = 4096;
+
+// Parses the value of -j or -w. Returns false unless all of `arg` is a
+// number from `min` to MAX_THREADS.
+static bool parse_count(const char* arg, size_t min, size_t& count) {
+    auto str = string_view(arg);
+    auto [end, ec] = from_chars(str.data(), str.data() + str.size(), count);
+    return ec == errc{} && end == str.data() + str.size() && count >= min && count <= MAX_THREADS;
+}
+
+static int usage(const string& error) {
+    cerr << error << endl;
+    cerr << "usage: ejdi [-j isolates] [-w workers] file.ejdi" << endl;
+    return 1;
+}
+
 int main(int argc, char* argv[]) {
+    auto shared = make_shared<ejdi::exec::isolate::Shared>();
+
+    size_t isolates = 1;
+    while (argc >= 3) {
+        auto option = string(argv[1]);
+        if (option == "-j") {
+            if (!parse_count(argv[2], 1, isolates)) {
+                return usage("-j takes a number of isolates from 1 to " + to_string(MAX_THREADS));
+            }
+        } else if (option == "-w") {
+            if (!parse_count(argv[2], 0, shared->worker_count)) {
+                return usage("-w takes a number of workers from 0 (one per hardware thread) to " + to_string(MAX_THREADS));
+            }
+        } else {
+            break;
+        }
+
+        argv += 2;
+        argc -= 2;
+    }
+
     if (argc < 2) {
-        cerr << "not enough arguments" << endl;
-        return 1;
+        return usage("not enough arguments");
     }
 
-    auto ctx = ejdi::exec::context::GlobalContext::with_core();
+    if (isolates > 1) {
+        auto failed = ejdi::exec::isolate::run(move(shared), argv[1], isolates);
+        return failed == 0 ? 0 : 1;
+    }
+
+    auto ctx = ejdi::exec::context::GlobalContext::with_core(move(shared));
     try {
         ctx.load_module(argv[1]);
     } catch (ejdi::exec::error::RuntimeError& e) {
         ctx.print_error_message(e);
+        return 1;
+    } catch (exception& e) {
+        // returning (instead of terminating) still writes out buffered output
+        ctx.flush();
+        cerr << "internal error: " << e.what() << endl;
+        return 1;
     }
 
     // auto file = ifstream(argv[1]);
@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include <exec/numbers.hpp>
+#include <exec/iterator.hpp>
+#include <exec/format.hpp>
+#include <exec/context.hpp>
+
+using namespace std;
+using namespace ejdi::exec::value;
+using namespace ejdi::exec::context;
+
+using Ctx = Context&;
+
+namespace ejdi::exec::numbers {
+    string_view NumberArray::type_name() const {
+        return NAME;
+    }
+
+    string_view NumberArray::vtable_name() const {
+        return "NumberArray";
+    }
+
+    shared_ptr<Native> NumberArray::transfer(const shared_ptr<Native>&, const CopyValue&) const {
+        return make_shared<NumberArray>(data);
+    }
+
+
+    // Reductions can't be auto-vectorized without -ffast-math (it would
+    // reorder the additions), so they are written with SSE intrinsics:
+    // two 4-lane accumulators, then a scalar tail.
+#if defined(__SSE2__)
+    static float horizontal_sum(__m128 v) {
+        auto shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+        auto sums = _mm_add_ps(v, shuf);
+        shuf = _mm_movehl_ps(shuf, sums);
+        sums = _mm_add_ss(sums, shuf);
+        return _mm_cvtss_f32(sums);
+    }
+#endif
+
+    float sum(const float* data, size_t size) {
+        size_t i = 0;
+        float res = 0;
+#if defined(__SSE2__)
+        auto acc0 = _mm_setzero_ps();
+        auto acc1 = _mm_setzero_ps();
+        for (; i + 8 <= size; i += 8) {
+            acc0 = _mm_add_ps(acc0, _mm_loadu_ps(data + i));
+            acc1 = _mm_add_ps(acc1, _mm_loadu_ps(data + i + 4));
+        }
+        res = horizontal_sum(_mm_add_ps(acc0, acc1));
+#endif
+        for (; i < size; i++) {
+            res += data[i];
+        }
+        return res;
+    }
+
+    float dot(const float* a, const float* b, size_t size) {
+        size_t i = 0;
+        float res = 0;
+#if defined(__SSE2__)
+        auto acc0 = _mm_setzero_ps();
+        auto acc1 = _mm_setzero_ps();
+        for (; i + 8 <= size; i += 8) {
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+        }
+        res = horizontal_sum(_mm_add_ps(acc0, acc1));
+#endif
+        for (; i < size; i++) {
+            res += a[i] * b[i];
+        }
+        return res;
+    }
+
+    float min(const float* data, size_t size) {
+        size_t i = 0;
+        float res = numeric_limits<float>::infinity();
+#if defined(__SSE2__)
+        if (size >= 4) {
+            auto acc = _mm_loadu_ps(data);
+            for (i = 4; i + 4 <= size; i += 4) {
+                acc = _mm_min_ps(acc, _mm_loadu_ps(data + i));
+            }
+            float lanes[4];
+            _mm_storeu_ps(lanes, acc);
+            res = std::min({ lanes[0], lanes[1], lanes[2], lanes[3] });
+        }
+#endif
+        for (; i < size; i++) {
+            res = std::min(res, data[i]);
+        }
+        return res;
+    }
+
+    float max(const float* data, size_t size) {
+        size_t i = 0;
+        float res = -numeric_limits<float>::infinity();
+#if defined(__SSE2__)
+        if (size >= 4) {
+            auto acc = _mm_loadu_ps(data);
+            for (i = 4; i + 4 <= size; i += 4) {
+                acc = _mm_max_ps(acc, _mm_loadu_ps(data + i));
+            }
+            float lanes[4];
+            _mm_storeu_ps(lanes, acc);
+            res = std::max({ lanes[0], lanes[1], lanes[2], lanes[3] });
+        }
+#endif
+        for (; i < size; i++) {
+            res = std::max(res, data[i]);
+        }
+        return res;
+    }
+
+    // Elementwise kernels are simple enough for the compiler to vectorize.
+    void add(const float* __restrict a, const float* __restrict b, float* __restrict out, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            out[i] = a[i] + b[i];
+        }
+    }
+
+    void mul(const float* __restrict a, const float* __restrict b, float* __restrict out, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            out[i] = a[i] * b[i];
+        }
+    }
+
+    void scale(const float* __restrict a, float factor, float* __restrict out, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            out[i] = a[i] * factor;
+        }
+    }
+
+    void fill(float* out, float value, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            out[i] = value;
+        }
+    }
+
+
+    Value make(Ctx ctx, Value from) {
+        if (from.is<float>()) {
+            auto data = vector<float>();
+            auto size = to_capacity(ctx, from.as<float>(), sizeof(float), "invalid number array size");
+            data.resize(size, 0.0f);
+            return make_shared<NumberArray>(move(data));
+        }
+
+        auto& arr = *from.as<Array>();
+        vector<float> data;
+        data.reserve(arr.size());
+        for (auto& elem : arr) {
+            data.push_back(elem.as<float>());
+        }
+
+        return make_shared<NumberArray>(move(data));
+    }
+
+    template< typename F >
+    static Value elementwise(Ctx ctx, NumberArray& a, NumberArray& b, F kernel) {
+        if (a.data.size() != b.data.size()) {
+            throw ctx.error("number arrays have different lengths");
+        }
+
+        auto res = make_shared<NumberArray>(vector<float>(a.data.size()));
+        kernel(a.data.data(), b.data.data(), res->data.data(), a.data.size());
+        return res;
+    }
+
+    static size_t checked_index(Ctx ctx, NumberArray& arr, float index) {
+        return to_index(ctx, index, arr.data.size(), "array index out of bounds");
+    }
+
+    Value prototype() {
+        auto obj = make_shared<Object>();
+        obj->set("to_s",
+                 Function::native_expanded<NumberArray>(
+                     [](Ctx, auto arr) {
+                         string res = "[";
+                         for (size_t i = 0; i < arr->data.size(); i++) {
+                             if (i != 0) {
+                                 res += ", ";
+                             }
+                             format::number(res, arr->data[i]);
+                         }
+                         res += ']';
+
+                         return res;
+                     })
+            );
+        obj->set("len",
+                 Function::native_expanded<NumberArray>(
+                     [](Ctx, auto arr) {
+                         return (float)arr->data.size();
+                     })
+            );
+        obj->set("at",
+                 Function::native_expanded<NumberArray, float>(
+                     [](Ctx ctx, auto arr, float index) {
+                         return arr->data[checked_index(ctx, *arr, index)];
+                     })
+            );
+        obj->set("set",
+                 Function::native_expanded<NumberArray, float, float>(
+                     [](Ctx ctx, auto arr, float index, float val) {
+                         arr->data[checked_index(ctx, *arr, index)] = val;
+                         return Unit{};
+                     })
+            );
+        obj->set("push",
+                 Function::native_expanded<NumberArray, float>(
+                     [](Ctx, auto arr, float val) {
+                         arr->data.push_back(val);
+                         return Unit{};
+                     })
+            );
+        obj->set("to_array",
+                 Function::native_expanded<NumberArray>(
+                     [](Ctx, auto arr) {
+                         auto res = make_shared<Array>();
+                         res->reserve(arr->data.size());
+                         for (auto elem : arr->data) {
+                             res->push_back(elem);
+                         }
+                         return res;
+                     })
+            );
+        obj->set("sum",
+                 Function::native_expanded<NumberArray>(
+                     [](Ctx, auto arr) {
+                         return sum(arr->data.data(), arr->data.size());
+                     })
+            );
+        obj->set("min",
+                 Function::native_expanded<NumberArray>(
+                     [](Ctx, auto arr) -> Value {
+                         if (arr->data.empty()) {
+                             return Unit{};
+                         }
+                         return min(arr->data.data(), arr->data.size());
+                     })
+            );
+        obj->set("max",
+                 Function::native_expanded<NumberArray>(
+                     [](Ctx, auto arr) -> Value {
+                         if (arr->data.empty()) {
+                             return Unit{};
+                         }
+                         return max(arr->data.data(), arr->data.size());
+                     })
+            );
+        obj->set("dot",
+                 Function::native_expanded<NumberArray, NumberArray>(
+                     [](Ctx ctx, auto a, auto b) {
+                         if (a->data.size() != b->data.size()) {
+                             throw ctx.error("number arrays have different lengths");
+                         }
+                         return dot(a->data.data(), b->data.data(), a->data.size());
+                     })
+            );
+        obj->set("add",
+                 Function::native_expanded<NumberArray, NumberArray>(
+                     [](Ctx ctx, auto a, auto b) {
+                         return elementwise(ctx, *a, *b, add);
+                     })
+            );
+        obj->set("mul",
+                 Function::native_expanded<NumberArray, NumberArray>(
+                     [](Ctx ctx, auto a, auto b) {
+                         return elementwise(ctx, *a, *b, mul);
+                     })
+            );
+        obj->set("scale",
+                 Function::native_expanded<NumberArray, float>(
+                     [](Ctx, auto arr, float factor) {
+                         auto res = make_shared<NumberArray>(vector<float>(arr->data.size()));
+                         scale(arr->data.data(), factor, res->data.data(), arr->data.size());
+                         return res;
+                     })
+            );
+        obj->set("fill",
+                 Function::native_expanded<NumberArray, float>(
+                     [](Ctx, auto arr, float val) {
+                         fill(arr->data.data(), val, arr->data.size());
+                         return arr;
+                     })
+            );
+        obj->set("__iter",
+                 Function::native_expanded<NumberArray>(
+                     [](Ctx, auto arr) {
+                         return iterator::make(
+                             [arr, i = size_t(0)](Ctx) mutable -> optional<Value> {
+                                 if (i < arr->data.size()) {
+                                     return Value(arr->data[i++]);
+                                 } else {
+                                     return nullopt;
+                                 }
+                             });
+                     })
+            );
+
+        return obj;
+    }
+}
@@ -0,0 +1,98 @@
+#include <cerrno>
+#include <utility>
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <exec/output.hpp>
+
+using namespace std;
+
+namespace ejdi::exec::output {
+    Sink::Sink(int fd)
+        : fd(fd)
+        , tty(isatty(fd))
+    {
+        buffer.reserve(CAPACITY);
+    }
+
+    Sink::~Sink() {
+        flush();
+    }
+
+    // Writes the buffer followed by `extra`, retrying short writes. Output
+    // that can't be written (a closed pipe, a full disk, ...) is dropped and
+    // the error remembered.
+    void Sink::write_out(string_view extra) {
+        iovec parts[2] = {
+            { buffer.data(), buffer.size() },
+            { const_cast<char*>(extra.data()), extra.size() },
+        };
+        auto* part = parts;
+        auto* end = parts + 2;
+
+        while (part != end) {
+            if (part->iov_len == 0) {
+                part++;
+                continue;
+            }
+
+            auto written = writev(fd, part, end - part);
+            stats_.syscalls++;
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (error == 0) {
+                    error = errno;
+                }
+                break;
+            }
+
+            stats_.bytes += written;
+            for (; part != end && size_t(written) >= part->iov_len; part++) {
+                written -= part->iov_len;
+            }
+            if (part != end) {
+                part->iov_base = static_cast<char*>(part->iov_base) + written;
+                part->iov_len -= written;
+            }
+        }
+
+        buffer.clear();
+    }
+
+    void Sink::write(string_view str) {
+        auto lock = lock_guard(mutex);
+
+        if (buffer.size() + str.size() > CAPACITY) {
+            if (str.size() >= CAPACITY) {
+                write_out(str);
+                return;
+            }
+            write_out({});
+        }
+
+        buffer += str;
+        if (tty && str.find('\n') != string_view::npos) {
+            write_out({});
+        }
+    }
+
+    void Sink::flush() {
+        auto lock = lock_guard(mutex);
+        if (!buffer.empty()) {
+            write_out({});
+        }
+    }
+
+    Sink::Stats Sink::stats() {
+        auto lock = lock_guard(mutex);
+        return stats_;
+    }
+
+    int Sink::take_error() {
+        auto lock = lock_guard(mutex);
+        return exchange(error, 0);
+    }
+}
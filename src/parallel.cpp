@@ -0,0 +1,427 @@
+#include <optional>
+#include <unordered_set>
+#include <algorithm>
+
+#include <exec/parallel.hpp>
+#include <exec/scheduler.hpp>
+
+using namespace std;
+using namespace ejdi::ast;
+using namespace ejdi::exec::value;
+using namespace ejdi::exec::context;
+using namespace ejdi::exec::isolate;
+using namespace ejdi::exec::scheduler;
+
+using Ctx = Context&;
+
+namespace ejdi::exec::parallel {
+    // Arrays shorter than this aren't worth shipping to other isolates.
+    static constexpr size_t SEQUENTIAL_BELOW = 1024;
+
+    // Prelude functions that only build new values or inspect their
+    // arguments. The rest do I/O (print, readline, flush, ...), touch state
+    // other isolates can see (spawn, channel, require, ...), answer
+    // differently on a worker (isolate, clock) or may hand back or modify
+    // their argument (freeze, iter).
+    static const unordered_set<string> PURE_PRELUDE_FUNCTIONS = {
+        "obj", "numbers", "range", "map", "set", "regex", "frozen",
+    };
+
+    // Methods that never modify the value they're called on. Anything else
+    // called on a value the function didn't create itself could change the
+    // caller's data, which on a worker would only change a detached copy.
+    // Methods are matched by name alone, so one that modifies any type's
+    // values stays out: NumberArray `add` returns a new array like `mul`
+    // does, but Set `add` inserts.
+    static const unordered_set<string> READ_ONLY_METHODS = {
+        "len", "at", "slice", "concat", "map", "filter", "reduce", "any", "all",
+        "find", "rfind", "for_each", "contains", "starts_with", "ends_with",
+        "split", "replace", "lines", "trim", "upper", "lower", "join", "to_s",
+        "to_n", "get", "has", "keys", "values", "to_array", "sum", "min", "max",
+        "dot", "mul", "scale", "match", "find_all", "captures", "floor", "ceil",
+        "round", "chr", "ord", "pow",
+    };
+
+    // Walks a function body looking for anything that depends on the
+    // caller's heap. Scoping is approximated by flat sets of names: `owned`
+    // locals hold values the function made itself and may be modified,
+    // `borrowed` ones (arguments, loop variables, and anything that may
+    // alias them) are read-only.
+    struct SafetyCheck {
+        unordered_set<string> owned;
+        unordered_set<string> borrowed;
+        bool safe = true;
+
+        void stmt(const Stmt& stmt) {
+            visit([this](const auto& node) { this->check(*node); }, stmt);
+        }
+
+        void expr(const Expr& expr) {
+            visit([this](const auto& node) { this->check(*node); }, expr);
+        }
+
+        bool is_owned(const string& name) const {
+            return owned.find(name) != owned.end();
+        }
+
+        bool is_local(const string& name) const {
+            return is_owned(name) || borrowed.find(name) != borrowed.end();
+        }
+
+        bool is_prelude_function(const string& name) const {
+            return !is_local(name) && PURE_PRELUDE_FUNCTIONS.count(name) != 0;
+        }
+
+        bool is_owned_variable(const Expr& expr) const {
+            return ast_is<Variable>(expr) && is_owned(ast_get<Variable>(expr)->variable.str);
+        }
+
+        // Whether `expr` always makes a new value that nothing else refers to.
+        bool is_fresh(const Expr& expr) const {
+            if (ast_is<FunctionCall>(expr)) {
+                // prelude constructors
+                const auto& function = ast_get<FunctionCall>(expr)->function;
+                if (!ast_is<Variable>(function)) {
+                    return false;
+                }
+                const auto& name = ast_get<Variable>(function)->variable.str;
+                return is_prelude_function(name);
+            }
+
+            return ast_is<ArrayLiteral>(expr) || ast_is<ObjectLiteral>(expr)
+                || ast_is<StringLiteral>(expr) || ast_is<NumberLiteral>(expr)
+                || ast_is<BoolLiteral>(expr) || ast_is<BinaryOp>(expr)
+                || ast_is<UnaryOp>(expr) || ast_is<FunctionLiteral>(expr);
+        }
+
+        void bind(const string& name, const Expr& value) {
+            if (is_fresh(value) && borrowed.find(name) == borrowed.end()) {
+                owned.insert(name);
+            } else {
+                owned.erase(name);
+                borrowed.insert(name);
+            }
+        }
+
+        void check(const Assignment& assign) {
+            if (assign.base.has_value()) {
+                expr(*assign.base);
+                // only objects the function made itself may be modified
+                if (!is_owned_variable(*assign.base)) {
+                    safe = false;
+                }
+            } else if (!assign.let.has_value() && !is_local(assign.field.str)) {
+                safe = false;
+            }
+
+            expr(assign.expr);
+
+            if (!assign.base.has_value()) {
+                bind(assign.field.str, assign.expr);
+            }
+        }
+
+        void check(const ExprStmt& stmt) {
+            expr(stmt.expr);
+        }
+
+        void check(const EmptyStmt&) {}
+
+        void check(const Variable& var) {
+            const auto& name = var.variable.str;
+            if (!is_local(name) && !is_prelude_function(name)) {
+                safe = false;
+            }
+        }
+
+        void check(const Block& block) {
+            for (const auto& s : block.statements) {
+                stmt(s);
+            }
+            if (block.ret.has_value()) {
+                expr(*block.ret);
+            }
+        }
+
+        void check(const BinaryOp& op) {
+            expr(op.left);
+            expr(op.right);
+        }
+
+        void check(const UnaryOp& op) {
+            expr(op.expr);
+        }
+
+        void check(const FunctionCall& call) {
+            expr(call.function);
+            // a function taken from a borrowed value may modify anything
+            if (!ast_is<Variable>(call.function)) {
+                safe = false;
+            } else {
+                const auto& name = ast_get<Variable>(call.function)->variable.str;
+                if (!is_owned(name) && !is_prelude_function(name)) {
+                    safe = false;
+                }
+            }
+            for (const auto& arg : call.arguments->list) {
+                expr(arg);
+            }
+        }
+
+        void check(const FieldAccess& access) {
+            expr(access.base);
+        }
+
+        void check(const MethodCall& call) {
+            expr(call.base);
+            if (!is_owned_variable(call.base) && READ_ONLY_METHODS.count(call.method.str) == 0) {
+                safe = false;
+            }
+            for (const auto& arg : call.arguments->list) {
+                expr(arg);
+            }
+        }
+
+        void check(const WhileLoop& loop) {
+            expr(loop.condition);
+            check(*loop.block);
+        }
+
+        void check(const ForLoop& loop) {
+            expr(loop.iterable);
+            owned.erase(loop.variable.str);
+            borrowed.insert(loop.variable.str);
+            check(*loop.body);
+        }
+
+        void check(const IfThenElse& cond) {
+            expr(cond.condition);
+            check(*cond.then);
+            if (cond.else_.has_value()) {
+                check(*get<1>(*cond.else_));
+            }
+        }
+
+        void check(const StringLiteral&) {}
+        void check(const NumberLiteral&) {}
+        void check(const BoolLiteral&) {}
+
+        void check(const ArrayLiteral& lit) {
+            for (const auto& elem : lit.elements->list) {
+                expr(elem);
+            }
+        }
+
+        void check(const ObjectLiteral& lit) {
+            for (const auto& field : lit.fields->list) {
+                expr(field.value);
+            }
+        }
+
+        void check(const FunctionLiteral& lit) {
+            for (const auto& arg : lit.argnames->list) {
+                owned.erase(arg.str);
+                borrowed.insert(arg.str);
+            }
+            expr(lit.body);
+        }
+    };
+
+    bool is_parallel_safe(Ctx ctx, const Function& func) {
+        auto lang = func.lang_function();
+        if (lang == nullptr) {
+            return false;
+        }
+
+        auto check = SafetyCheck {};
+        for (const auto& arg : lang->argnames->list) {
+            check.borrowed.insert(arg.str);
+        }
+        check.expr(lang->body);
+
+        return check.safe;
+    }
+
+
+    enum class Op {
+        Map,
+        Filter,
+        Reduce,
+    };
+
+    // The sequential kernel, used both on the calling thread and for each
+    // chunk on the workers. Chunks are never empty, so Reduce starts from
+    // the chunk's first element. Map returns the results and Filter whether
+    // to keep each element, which the caller picks from its own array.
+    static Value run_chunk(Ctx ctx, Op op, Function& func, Array& chunk) {
+        if (op == Op::Reduce) {
+            auto acc = chunk[0];
+            for (size_t i = 1; i < chunk.size(); i++) {
+                acc = func.call(ctx, { move(acc), chunk[i] });
+            }
+            return acc;
+        }
+
+        auto res = make_shared<Array>();
+        res->reserve(chunk.size());
+        for (auto& elem : chunk) {
+            auto result = func.call(ctx, { elem });
+            if (op == Op::Filter) {
+                // checked here so a non-boolean fails like it does sequentially
+                result = result.as<bool>();
+            }
+            res->push_back(move(result));
+        }
+
+        return res;
+    }
+
+    static bool run_sequentially(Ctx ctx, Array& arr, Function& func) {
+        return arr.size() < SEQUENTIAL_BELOW || !is_parallel_safe(ctx, func);
+    }
+
+    // Detaches every chunk before submitting any, so that an array holding
+    // something that can't leave the isolate (a file, ...) gives nullopt and
+    // the caller runs it sequentially instead of failing.
+    static optional<vector<Value>> run_chunks(Ctx ctx, Op op, Array& arr, shared_ptr<Function> func) {
+        auto& scheduler = ctx.global.shared->scheduler();
+
+        auto kernel = Function::native(
+            [op, func](Ctx ctx, vector<Value> args) {
+                return run_chunk(ctx, op, *func, *args[0].as<Array>());
+            }).as<Function>();
+
+        auto chunks = min(scheduler.size() * 4, arr.size() / (SEQUENTIAL_BELOW / 4));
+        auto chunk_size = (arr.size() + chunks - 1) / chunks;
+
+        vector<Message> messages;
+        try {
+            for (size_t start = 0; start < arr.size(); start += chunk_size) {
+                auto end = min(start + chunk_size, arr.size());
+                auto chunk = detach(ctx, make_shared<Array>(arr.begin() + start, arr.begin() + end));
+                chunk.value = Array { move(chunk.value) };
+                messages.push_back(move(chunk));
+            }
+        } catch (error::RuntimeError&) {
+            return nullopt;
+        }
+
+        vector<shared_ptr<Future>> futures;
+        for (auto& chunk : messages) {
+            auto future = make_shared<Future>();
+            scheduler.submit(Task { kernel, move(chunk), ctx.module_path, future });
+            futures.push_back(move(future));
+        }
+
+        vector<Value> results;
+        results.reserve(futures.size());
+        for (auto& future : futures) {
+            results.push_back(await(ctx, move(future)));
+        }
+
+        return results;
+    }
+
+    static Value concat(vector<Value> parts, size_t size_hint) {
+        auto res = make_shared<Array>();
+        res->reserve(size_hint);
+        for (auto& part : parts) {
+            auto& arr = *part.as<Array>();
+            res->insert(res->end(), make_move_iterator(arr.begin()), make_move_iterator(arr.end()));
+        }
+
+        return res;
+    }
+
+    // What a parallel-safe `func` returns is copied on the calling thread
+    // too, so the result doesn't depend on whether the array was large
+    // enough for the pool. A value that can't be copied means the array
+    // holds something that never reaches the pool either, and is kept.
+    static Value copied(Ctx ctx, Value value) {
+        try {
+            return attach(ctx, detach(ctx, value));
+        } catch (error::RuntimeError&) {
+            return value;
+        }
+    }
+
+    static bool same_type(Value& a, Value& b) {
+        if (a.value.index() != b.value.index()) {
+            return false;
+        } else if (a.is<Native>()) {
+            return a.as<Native>()->type_name() == b.as<Native>()->type_name();
+        } else {
+            return true;
+        }
+    }
+
+    Value par_map(Ctx ctx, shared_ptr<Array> arr, shared_ptr<Function> func) {
+        if (!is_parallel_safe(ctx, *func)) {
+            return run_chunk(ctx, Op::Map, *func, *arr);
+        }
+
+        if (arr->size() >= SEQUENTIAL_BELOW) {
+            if (auto parts = run_chunks(ctx, Op::Map, *arr, func)) {
+                return concat(move(*parts), arr->size());
+            }
+        }
+
+        return copied(ctx, run_chunk(ctx, Op::Map, *func, *arr));
+    }
+
+    Value par_filter(Ctx ctx, shared_ptr<Array> arr, shared_ptr<Function> func) {
+        if (!run_sequentially(ctx, *arr, *func)) {
+            if (auto parts = run_chunks(ctx, Op::Filter, *arr, func)) {
+                // the workers only send back which elements to keep, so
+                // the result holds the elements themselves, not copies
+                auto res = make_shared<Array>();
+                size_t index = 0;
+                for (auto& part : *parts) {
+                    for (auto& keep : *part.as<Array>()) {
+                        if (keep.as<bool>()) {
+                            res->push_back((*arr)[index]);
+                        }
+                        index++;
+                    }
+                }
+                return res;
+            }
+        }
+
+        auto res = make_shared<Array>();
+        for (auto& elem : *arr) {
+            if (func->call(ctx, { elem }).as<bool>()) {
+                res->push_back(elem);
+            }
+        }
+        return res;
+    }
+
+    Value par_reduce(Ctx ctx, shared_ptr<Array> arr, shared_ptr<Function> func, Value init) {
+        if (!is_parallel_safe(ctx, *func)) {
+            for (auto& elem : *arr) {
+                init = func->call(ctx, { move(init), elem });
+            }
+            return init;
+        }
+
+        // chunks are reduced from their own first element, so they only
+        // stand in for `init` when it has the elements' type; a reduction
+        // into another type (summing a field of objects, ...) stays here
+        auto uniform = all_of(arr->begin(), arr->end(),
+                              [&](Value& elem) { return same_type(elem, init); });
+        if (arr->size() >= SEQUENTIAL_BELOW && uniform) {
+            if (auto parts = run_chunks(ctx, Op::Reduce, *arr, func)) {
+                for (auto& part : *parts) {
+                    init = func->call(ctx, { move(init), move(part) });
+                }
+                return copied(ctx, init);
+            }
+        }
+
+        for (auto& elem : *arr) {
+            init = func->call(ctx, { move(init), elem });
+        }
+        return copied(ctx, init);
+    }
+}
@@ -99,6 +99,12 @@ ParserResult<Expr> parser::parse_primary_expr(ParseStream& in) {
         return Expr(move(array.get()));
     }
 
+    auto object = DO(parse_object_literal(stream));
+    if (object.has_result()) {
+        in = stream;
+        return Expr(move(object.get()));
+    }
+
     auto block = DO(parse_block(stream));
     if (block.has_result()) {
         in = stream;
@@ -454,6 +460,32 @@ ParserResult<Rc<ArrayLiteral>> parser::parse_array_literal(ParseStream& in) {
     return make_shared<ArrayLiteral>(ArrayLiteral { move(list) });
 }
 
+ParserResult<ObjectField> parser::parse_object_field(ParseStream& in) {
+    auto stream = in.clone();
+
+    auto name = TRY(parse<Word>(stream));
+    auto colon = TRY_CRITICAL(parse_str<Punct>(":", stream));
+    auto value = TRY_CRITICAL(parse_expr(stream));
+
+    in = stream;
+
+    return ObjectField { name, colon, move(value) };
+}
+
+ParserResult<Rc<ObjectLiteral>> parser::parse_object_literal(ParseStream& in) {
+    auto stream = in.clone();
+    auto group = TRY(parse<Rc<Group>>(stream));
+
+    auto group_stream = ParseStream(*group);
+    if (group->surrounding.str != "{}" || !group_stream.parse<Word>().has_result() || !group_stream.peek(":")) {
+        return in.expected("object literal");
+    }
+
+    auto fields = TRY_CRITICAL(parse_list<ObjectField>(parse_object_field, "{}", in));
+
+    return make_shared<ObjectLiteral>(ObjectLiteral { move(fields) });
+}
+
 ParserResult<Rc<FunctionLiteral>> parser::parse_function_literal(ParseStream& in) {
     auto stream = in.clone();
 
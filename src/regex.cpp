@@ -0,0 +1,886 @@
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
+#include <exec/regex.hpp>
+#include <exec/context.hpp>
+
+using namespace std;
+using namespace ejdi::exec::value;
+using namespace ejdi::exec::context;
+
+using Ctx = Context&;
+
+namespace ejdi::exec::regex {
+    using Op = Regex::Op;
+    using Inst = Regex::Inst;
+    using ByteSet = Regex::ByteSet;
+
+    static constexpr auto npos = string_view::npos;
+    static constexpr uint32_t UNBOUNDED = numeric_limits<uint32_t>::max();
+    static constexpr uint32_t MAX_REPEAT = 1000;
+    static constexpr size_t MAX_PROGRAM = 1 << 16;
+    // The lazy DFA starts over once it has built this many states.
+    static constexpr size_t MAX_DFA_STATES = 4096;
+    static constexpr size_t MAX_CACHED = 512;
+
+    static void add(ByteSet& set, unsigned char byte) {
+        set[byte >> 6] |= uint64_t(1) << (byte & 63);
+    }
+
+    static void add_range(ByteSet& set, unsigned char from, unsigned char to) {
+        for (unsigned c = from; c <= to; c++) {
+            add(set, c);
+        }
+    }
+
+    static void negate(ByteSet& set) {
+        for (auto& word : set) {
+            word = ~word;
+        }
+    }
+
+    static void merge(ByteSet& set, const ByteSet& other) {
+        for (size_t i = 0; i < set.size(); i++) {
+            set[i] |= other[i];
+        }
+    }
+
+
+    struct Node {
+        enum Kind { Empty, Set, Concat, Alt, Repeat, Group, Begin, End };
+
+        Kind kind;
+        // Set: index into Regex::sets
+        uint32_t set = 0;
+        // Concat and Alt: the parts. Repeat and Group: the single child.
+        vector<Node> children;
+        uint32_t min = 0;
+        uint32_t max = 0;
+        bool greedy = true;
+        // Group: the capture index, or -1 for (?:...)
+        int32_t group = -1;
+    };
+
+    struct Parser {
+        Ctx ctx;
+        Regex& re;
+        string_view pat;
+        size_t pos = 0;
+
+        [[noreturn]] void fail(const string& why) {
+            string msg = "invalid regex '";
+            msg += re.pattern;
+            msg += "': ";
+            msg += why;
+            throw ctx.error(move(msg));
+        }
+
+        bool at_end() const {
+            return pos >= pat.size();
+        }
+
+        bool eat(char c) {
+            if (!at_end() && pat[pos] == c) {
+                pos++;
+                return true;
+            }
+            return false;
+        }
+
+        Node set_node(const ByteSet& set) {
+            Node node { Node::Set };
+            node.set = re.sets.size();
+            re.sets.push_back(set);
+            return node;
+        }
+
+        Node parse() {
+            auto node = alternation();
+            if (!at_end()) {
+                fail("unmatched ')'");
+            }
+            return node;
+        }
+
+        Node alternation() {
+            auto first = concatenation();
+            if (at_end() || pat[pos] != '|') {
+                return first;
+            }
+
+            Node node { Node::Alt };
+            node.children.push_back(move(first));
+            while (eat('|')) {
+                node.children.push_back(concatenation());
+            }
+            return node;
+        }
+
+        Node concatenation() {
+            Node node { Node::Concat };
+            while (!at_end() && pat[pos] != '|' && pat[pos] != ')') {
+                node.children.push_back(repetition());
+            }
+
+            if (node.children.empty()) {
+                return Node { Node::Empty };
+            } else if (node.children.size() == 1) {
+                return move(node.children[0]);
+            }
+            return node;
+        }
+
+        uint32_t number() {
+            uint32_t n = 0;
+            if (at_end() || !isdigit(static_cast<unsigned char>(pat[pos]))) {
+                fail("expected a number in {}");
+            }
+            while (!at_end() && isdigit(static_cast<unsigned char>(pat[pos]))) {
+                n = n * 10 + (pat[pos++] - '0');
+                if (n > MAX_REPEAT) {
+                    fail("repetition count is too large");
+                }
+            }
+            return n;
+        }
+
+        // `{` only starts a repetition when a digit follows, like in most
+        // other engines; otherwise it's a literal.
+        bool quantifier(uint32_t& min, uint32_t& max) {
+            if (eat('*')) {
+                min = 0, max = UNBOUNDED;
+            } else if (eat('+')) {
+                min = 1, max = UNBOUNDED;
+            } else if (eat('?')) {
+                min = 0, max = 1;
+            } else if (pos + 1 < pat.size() && pat[pos] == '{'
+                       && isdigit(static_cast<unsigned char>(pat[pos + 1]))) {
+                pos++;
+                min = max = number();
+                if (eat(',')) {
+                    max = (!at_end() && pat[pos] == '}') ? UNBOUNDED : number();
+                }
+                if (!eat('}')) {
+                    fail("expected '}'");
+                } else if (max < min) {
+                    fail("repetition range is reversed");
+                }
+            } else {
+                return false;
+            }
+            return true;
+        }
+
+        Node repetition() {
+            auto node = atom();
+
+            uint32_t min, max;
+            while (quantifier(min, max)) {
+                Node rep { Node::Repeat };
+                rep.min = min;
+                rep.max = max;
+                rep.greedy = !eat('?');
+                rep.children.push_back(move(node));
+                node = move(rep);
+            }
+            return node;
+        }
+
+        Node atom() {
+            auto c = pat[pos++];
+            switch (c) {
+                case '(': {
+                    Node node { Node::Group };
+                    if (eat('?')) {
+                        if (!eat(':')) {
+                            fail("only (?:...) groups are supported");
+                        }
+                    } else {
+                        node.group = re.groups++;
+                    }
+
+                    node.children.push_back(alternation());
+                    if (!eat(')')) {
+                        fail("unmatched '('");
+                    }
+                    return node;
+                }
+                case ')':
+                    fail("unmatched ')'");
+                case '*':
+                case '+':
+                case '?':
+                    fail("nothing to repeat");
+                case '[':
+                    return set_node(byte_class());
+                case '.': {
+                    ByteSet set {};
+                    negate(set);
+                    set[0] &= ~(uint64_t(1) << '\n');
+                    return set_node(set);
+                }
+                case '^':
+                    return Node { Node::Begin };
+                case '$':
+                    return Node { Node::End };
+                case '\\': {
+                    ByteSet set {};
+                    escape(set);
+                    return set_node(set);
+                }
+                default: {
+                    ByteSet set {};
+                    add(set, c);
+                    return set_node(set);
+                }
+            }
+        }
+
+        // Adds the escape after a backslash to `set`; returns the byte for
+        // single-byte escapes (which can start a range) or -1 for classes.
+        int escape(ByteSet& set) {
+            if (at_end()) {
+                fail("trailing backslash");
+            }
+
+            auto c = pat[pos++];
+            ByteSet cls {};
+            switch (c) {
+                case 'd': case 'D':
+                    add_range(cls, '0', '9');
+                    break;
+                case 'w': case 'W':
+                    add_range(cls, '0', '9');
+                    add_range(cls, 'a', 'z');
+                    add_range(cls, 'A', 'Z');
+                    add(cls, '_');
+                    break;
+                case 's': case 'S':
+                    for (auto space : string_view(" \t\n\r\v\f")) {
+                        add(cls, space);
+                    }
+                    break;
+                case 'n': add(set, '\n'); return '\n';
+                case 't': add(set, '\t'); return '\t';
+                case 'r': add(set, '\r'); return '\r';
+                case 'f': add(set, '\f'); return '\f';
+                case 'v': add(set, '\v'); return '\v';
+                default:
+                    if (isalnum(static_cast<unsigned char>(c))) {
+                        string msg = "unsupported escape \\";
+                        msg += c;
+                        fail(msg);
+                    }
+                    add(set, c);
+                    return static_cast<unsigned char>(c);
+            }
+
+            if (isupper(static_cast<unsigned char>(c))) {
+                negate(cls);
+            }
+            merge(set, cls);
+            return -1;
+        }
+
+        ByteSet byte_class() {
+            ByteSet set {};
+            bool negated = eat('^');
+
+            bool first = true;
+            while (at_end() || pat[pos] != ']' || first) {
+                if (at_end()) {
+                    fail("unterminated character class");
+                }
+                first = false;
+
+                int from;
+                if (eat('\\')) {
+                    from = escape(set);
+                } else {
+                    from = static_cast<unsigned char>(pat[pos++]);
+                    add(set, from);
+                }
+
+                if (from >= 0 && pos + 1 < pat.size() && pat[pos] == '-' && pat[pos + 1] != ']') {
+                    pos++;
+                    int to;
+                    if (eat('\\')) {
+                        ByteSet ignored {};
+                        to = escape(ignored);
+                        if (to < 0) {
+                            fail("character class range ends in a class");
+                        }
+                    } else {
+                        to = static_cast<unsigned char>(pat[pos++]);
+                    }
+
+                    if (to < from) {
+                        fail("character class range is reversed");
+                    }
+                    add_range(set, from, to);
+                }
+            }
+            pos++;
+
+            if (negated) {
+                negate(set);
+            }
+            return set;
+        }
+    };
+
+    struct Compiler {
+        Parser& parser;
+        vector<Inst>& prog;
+        // Nodes emitted so far. Repeats of empty bodies add no instructions,
+        // so MAX_PROGRAM alone doesn't stop (?:){1000}{1000}{1000} from
+        // taking a billion steps.
+        size_t steps = 0;
+
+        size_t push(Inst inst) {
+            if (prog.size() >= MAX_PROGRAM) {
+                parser.fail("pattern is too large");
+            }
+            prog.push_back(inst);
+            return prog.size() - 1;
+        }
+
+        void split(size_t at, uint32_t body, uint32_t skip, bool greedy) {
+            prog[at].x = greedy ? body : skip;
+            prog[at].y = greedy ? skip : body;
+        }
+
+        void emit(const Node& node) {
+            if (++steps > 4 * MAX_PROGRAM) {
+                parser.fail("pattern is too large");
+            }
+            switch (node.kind) {
+                case Node::Empty:
+                    break;
+                case Node::Set:
+                    push({ Op::Byte, node.set });
+                    break;
+                case Node::Concat:
+                    for (auto& child : node.children) {
+                        emit(child);
+                    }
+                    break;
+                case Node::Alt: {
+                    vector<size_t> jumps;
+                    for (size_t i = 0; i + 1 < node.children.size(); i++) {
+                        auto at = push({ Op::Split });
+                        prog[at].x = at + 1;
+                        emit(node.children[i]);
+                        jumps.push_back(push({ Op::Jump }));
+                        prog[at].y = prog.size();
+                    }
+                    emit(node.children.back());
+                    for (auto jump : jumps) {
+                        prog[jump].x = prog.size();
+                    }
+                    break;
+                }
+                case Node::Group:
+                    if (node.group >= 0) {
+                        push({ Op::Save, uint32_t(node.group * 2) });
+                    }
+                    emit(node.children[0]);
+                    if (node.group >= 0) {
+                        push({ Op::Save, uint32_t(node.group * 2 + 1) });
+                    }
+                    break;
+                case Node::Begin:
+                    push({ Op::Begin });
+                    break;
+                case Node::End:
+                    push({ Op::End });
+                    break;
+                case Node::Repeat:
+                    repeat(node);
+                    break;
+            }
+        }
+
+        void repeat(const Node& node) {
+            auto& body = node.children[0];
+
+            if (node.max == UNBOUNDED && node.min > 0) {
+                // x{n,} is n - 1 copies, then one that loops back
+                for (uint32_t i = 1; i < node.min; i++) {
+                    emit(body);
+                }
+                auto start = prog.size();
+                emit(body);
+                auto at = push({ Op::Split });
+                split(at, start, at + 1, node.greedy);
+                return;
+            }
+
+            for (uint32_t i = 0; i < node.min; i++) {
+                emit(body);
+            }
+
+            if (node.max == UNBOUNDED) {
+                auto at = push({ Op::Split });
+                emit(body);
+                push({ Op::Jump, uint32_t(at) });
+                split(at, at + 1, prog.size(), node.greedy);
+                return;
+            }
+
+            // x{n,m}: the optional copies are nested, (x(x)?)?, so each one
+            // can only match if the previous did
+            vector<size_t> splits;
+            for (auto i = node.min; i < node.max; i++) {
+                splits.push_back(push({ Op::Split }));
+                emit(body);
+            }
+            for (auto at : splits) {
+                split(at, at + 1, prog.size(), node.greedy);
+            }
+        }
+    };
+
+    static shared_ptr<Regex> build(Ctx ctx, const string& pattern) {
+        auto re = make_shared<Regex>();
+        re->pattern = pattern;
+
+        auto parser = Parser { ctx, *re, re->pattern };
+        auto root = parser.parse();
+
+        auto compiler = Compiler { parser, re->program };
+        compiler.push({ Op::Save, 0 });
+        compiler.emit(root);
+        compiler.push({ Op::Save, 1 });
+        compiler.push({ Op::Match });
+        return re;
+    }
+
+    shared_ptr<Regex> compile(Ctx ctx, const string& pattern) {
+        thread_local unordered_map<string, shared_ptr<Regex>> cache;
+
+        auto it = cache.find(pattern);
+        if (it != cache.end()) {
+            return it->second;
+        }
+
+        auto re = build(ctx, pattern);
+        if (cache.size() >= MAX_CACHED) {
+            cache.clear();
+        }
+        cache.emplace(pattern, re);
+        return re;
+    }
+
+
+    // The NFA states reachable from `pcs` without consuming input. Only
+    // the ones that wait for a byte, match, or (unless at the end) assert
+    // the end are kept.
+    vector<uint32_t> Regex::closure(vector<uint32_t> stack, bool begin, bool end) const {
+        vector<uint32_t> res;
+        vector<bool> seen(program.size());
+
+        while (!stack.empty()) {
+            auto pc = stack.back();
+            stack.pop_back();
+            if (seen[pc]) {
+                continue;
+            }
+            seen[pc] = true;
+
+            auto& inst = program[pc];
+            switch (inst.op) {
+                case Op::Byte:
+                case Op::Match:
+                    res.push_back(pc);
+                    break;
+                case Op::Split:
+                    stack.push_back(inst.y);
+                    stack.push_back(inst.x);
+                    break;
+                case Op::Jump:
+                    stack.push_back(inst.x);
+                    break;
+                case Op::Save:
+                    stack.push_back(pc + 1);
+                    break;
+                case Op::Begin:
+                    if (begin) {
+                        stack.push_back(pc + 1);
+                    }
+                    break;
+                case Op::End:
+                    if (end) {
+                        stack.push_back(pc + 1);
+                    } else {
+                        res.push_back(pc);
+                    }
+                    break;
+            }
+        }
+
+        sort(res.begin(), res.end());
+        return res;
+    }
+
+    int32_t Regex::dfa_state(vector<uint32_t> pcs) {
+        auto it = dfa_ids.find(pcs);
+        if (it != dfa_ids.end()) {
+            return it->second;
+        }
+
+        bool match = any_of(pcs.begin(), pcs.end(), [this](uint32_t pc) {
+            return program[pc].op == Op::Match;
+        });
+
+        int32_t id = dfa_states.size();
+        dfa_states.push_back({ pcs, match });
+        dfa_next.resize(dfa_next.size() + 256, -1);
+        dfa_ids.emplace(move(pcs), id);
+        return id;
+    }
+
+    // Unanchored search: every step also starts a new match attempt at
+    // the following position.
+    int32_t Regex::dfa_step(int32_t state, unsigned char byte) {
+        auto& cached = dfa_next[size_t(state) * 256 + byte];
+        if (cached >= 0) {
+            return cached;
+        }
+
+        vector<uint32_t> moved;
+        for (auto pc : dfa_states[state].pcs) {
+            auto& inst = program[pc];
+            if (inst.op == Op::Byte && contains(sets[inst.x], byte)) {
+                moved.push_back(pc + 1);
+            }
+        }
+        moved.push_back(0);
+        auto pcs = closure(move(moved), false, false);
+
+        if (dfa_states.size() >= MAX_DFA_STATES) {
+            dfa_states.clear();
+            dfa_next.clear();
+            dfa_ids.clear();
+            dfa_start = -1;
+            return dfa_state(move(pcs));
+        }
+
+        auto next = dfa_state(move(pcs));
+        dfa_next[size_t(state) * 256 + byte] = next;
+        return next;
+    }
+
+    bool Regex::is_match(string_view str) {
+        if (dfa_start < 0) {
+            dfa_start = dfa_state(closure({ 0 }, true, false));
+        }
+
+        auto state = dfa_start;
+        for (unsigned char byte : str) {
+            if (dfa_states[state].match) {
+                return true;
+            } else if (dfa_states[state].pcs.empty()) {
+                return false;
+            }
+            state = dfa_step(state, byte);
+        }
+
+        auto& last = dfa_states[state];
+        if (last.match_at_end < 0) {
+            auto pcs = closure(last.pcs, false, true);
+            last.match_at_end = any_of(pcs.begin(), pcs.end(), [this](uint32_t pc) {
+                return program[pc].op == Op::Match;
+            });
+        }
+        return last.match || last.match_at_end;
+    }
+
+
+    // Threads are kept in priority order, each with its own capture slots,
+    // and a state is entered by at most one thread per position, so the
+    // first thread to reach Match is the leftmost-first match.
+    class PikeVm {
+        struct Threads {
+            vector<uint32_t> dense;
+            vector<uint32_t> sparse;
+            vector<size_t> caps;
+            size_t size = 0;
+
+            Threads(size_t states, size_t slots)
+                : dense(states), sparse(states), caps(states * slots) {}
+
+            bool contains(uint32_t pc) const {
+                return sparse[pc] < size && dense[sparse[pc]] == pc;
+            }
+
+            void insert(uint32_t pc) {
+                sparse[pc] = size;
+                dense[size++] = pc;
+            }
+        };
+
+        struct Frame {
+            bool restore;
+            uint32_t pc_or_slot;
+            size_t old;
+        };
+
+        const Regex& re;
+        string_view str;
+        size_t slots;
+        Threads clist;
+        Threads nlist;
+        vector<size_t> scratch;
+        vector<Frame> stack;
+
+        // Follows the empty transitions from pc with the captures in
+        // `scratch`, which are left unchanged.
+        void add(Threads& list, uint32_t pc, size_t pos) {
+            stack.push_back({ false, pc, 0 });
+            while (!stack.empty()) {
+                auto frame = stack.back();
+                stack.pop_back();
+                if (frame.restore) {
+                    scratch[frame.pc_or_slot] = frame.old;
+                    continue;
+                }
+
+                pc = frame.pc_or_slot;
+                if (list.contains(pc)) {
+                    continue;
+                }
+                list.insert(pc);
+
+                auto& inst = re.program[pc];
+                switch (inst.op) {
+                    case Op::Byte:
+                    case Op::Match:
+                        copy(scratch.begin(), scratch.end(), list.caps.begin() + pc * slots);
+                        break;
+                    case Op::Split:
+                        stack.push_back({ false, inst.y, 0 });
+                        stack.push_back({ false, inst.x, 0 });
+                        break;
+                    case Op::Jump:
+                        stack.push_back({ false, inst.x, 0 });
+                        break;
+                    case Op::Save:
+                        stack.push_back({ true, inst.x, scratch[inst.x] });
+                        scratch[inst.x] = pos;
+                        stack.push_back({ false, pc + 1, 0 });
+                        break;
+                    case Op::Begin:
+                        if (pos == 0) {
+                            stack.push_back({ false, pc + 1, 0 });
+                        }
+                        break;
+                    case Op::End:
+                        if (pos == str.size()) {
+                            stack.push_back({ false, pc + 1, 0 });
+                        }
+                        break;
+                }
+            }
+        }
+
+    public:
+        PikeVm(const Regex& re, string_view str)
+            : re(re)
+            , str(str)
+            , slots(re.groups * 2)
+            , clist(re.program.size(), slots)
+            , nlist(re.program.size(), slots)
+            , scratch(slots) {}
+
+        vector<size_t> find(size_t from) {
+            vector<size_t> matched;
+            clist.size = 0;
+
+            for (auto pos = from; ; pos++) {
+                if (matched.empty()) {
+                    fill(scratch.begin(), scratch.end(), npos);
+                    add(clist, 0, pos);
+                }
+                if (clist.size == 0) {
+                    break;
+                }
+
+                nlist.size = 0;
+                for (size_t i = 0; i < clist.size; i++) {
+                    auto pc = clist.dense[i];
+                    auto caps = clist.caps.begin() + pc * slots;
+                    auto& inst = re.program[pc];
+
+                    if (inst.op == Op::Byte) {
+                        if (pos < str.size() && Regex::contains(re.sets[inst.x], str[pos])) {
+                            copy(caps, caps + slots, scratch.begin());
+                            add(nlist, pc + 1, pos + 1);
+                        }
+                    } else if (inst.op == Op::Match) {
+                        // lower priority threads are cut off
+                        matched.assign(caps, caps + slots);
+                        break;
+                    }
+                }
+
+                swap(clist, nlist);
+                if (pos >= str.size()) {
+                    break;
+                }
+            }
+
+            return matched;
+        }
+    };
+
+    void Regex::for_each_match(string_view str, const function<bool(const vector<size_t>&)>& on_match) {
+        if (!is_match(str)) {
+            return;
+        }
+
+        auto vm = PikeVm(*this, str);
+        size_t from = 0;
+        while (from <= str.size()) {
+            auto caps = vm.find(from);
+            if (caps.empty() || !on_match(caps)) {
+                return;
+            }
+            // an empty match moves on by one byte, so the search ends
+            from = caps[1] > caps[0] ? caps[1] : caps[1] + 1;
+        }
+    }
+
+    string_view Regex::type_name() const {
+        return NAME;
+    }
+
+    string_view Regex::vtable_name() const {
+        return "Regex";
+    }
+
+    shared_ptr<Native> Regex::transfer(const shared_ptr<Native>&, const CopyValue&) const {
+        return make_shared<Regex>(*this);
+    }
+
+
+    static Value group(string_view str, const vector<size_t>& caps, size_t index) {
+        if (caps[index * 2] == npos) {
+            return Unit{};
+        }
+        return string(str.substr(caps[index * 2], caps[index * 2 + 1] - caps[index * 2]));
+    }
+
+    // `$n` is replaced with group n, and `$$` with `$`.
+    static void expand(Ctx ctx, const Regex& re, string_view with, string_view str,
+                       const vector<size_t>& caps, string& out) {
+        for (size_t i = 0; i < with.size(); i++) {
+            if (with[i] != '$' || i + 1 == with.size()) {
+                out += with[i];
+            } else if (with[i + 1] == '$') {
+                out += '$';
+                i++;
+            } else if (isdigit(static_cast<unsigned char>(with[i + 1]))) {
+                size_t index = with[++i] - '0';
+                if (index >= re.groups) {
+                    string msg = "regex has no group $";
+                    msg += with[i];
+                    throw ctx.error(move(msg));
+                }
+                if (caps[index * 2] != npos) {
+                    out.append(str.substr(caps[index * 2], caps[index * 2 + 1] - caps[index * 2]));
+                }
+            } else {
+                out += '$';
+            }
+        }
+    }
+
+    Value prototype() {
+        auto obj = make_shared<Object>();
+        obj->set("to_s",
+                 Function::native_expanded<Regex>(
+                     [](Ctx, auto re) {
+                         return "regex(" + re->pattern + ")";
+                     })
+            );
+        obj->set("match",
+                 Function::native_expanded<Regex, string>(
+                     [](Ctx, auto re, auto str) {
+                         return re->is_match(*str);
+                     })
+            );
+        obj->set("find",
+                 Function::native_expanded<Regex, string>(
+                     [](Ctx, auto re, auto str) {
+                         Value res = Unit{};
+                         re->for_each_match(*str, [&](auto& caps) {
+                             res = group(*str, caps, 0);
+                             return false;
+                         });
+                         return res;
+                     })
+            );
+        obj->set("find_all",
+                 Function::native_expanded<Regex, string>(
+                     [](Ctx, auto re, auto str) {
+                         auto res = make_shared<Array>();
+                         re->for_each_match(*str, [&](auto& caps) {
+                             res->push_back(group(*str, caps, 0));
+                             return true;
+                         });
+                         return res;
+                     })
+            );
+        obj->set("captures",
+                 Function::native_expanded<Regex, string>(
+                     [](Ctx, auto re, auto str) {
+                         Value res = Unit{};
+                         re->for_each_match(*str, [&](auto& caps) {
+                             auto groups = make_shared<Array>();
+                             for (size_t i = 0; i < re->groups; i++) {
+                                 groups->push_back(group(*str, caps, i));
+                             }
+                             res = move(groups);
+                             return false;
+                         });
+                         return res;
+                     })
+            );
+        obj->set("split",
+                 Function::native_expanded<Regex, string>(
+                     [](Ctx, auto re, auto str) {
+                         auto res = make_shared<Array>();
+                         size_t start = 0;
+                         re->for_each_match(*str, [&](auto& caps) {
+                             // empty matches at either end don't split
+                             if (caps[1] > caps[0] || (caps[0] > 0 && caps[0] < str->size())) {
+                                 res->push_back(str->substr(start, caps[0] - start));
+                                 start = caps[1];
+                             }
+                             return true;
+                         });
+                         res->push_back(str->substr(start));
+                         return res;
+                     })
+            );
+        obj->set("replace",
+                 Function::native_expanded<Regex, string, string>(
+                     [](Ctx ctx, auto re, auto str, auto with) {
+                         string res;
+                         size_t start = 0;
+                         re->for_each_match(*str, [&](auto& caps) {
+                             res.append(*str, start, caps[0] - start);
+                             expand(ctx, *re, *with, *str, caps, res);
+                             start = caps[1];
+                             return true;
+                         });
+                         res.append(*str, start);
+                         return res;
+                     })
+            );
+
+        return obj;
+    }
+}
@@ -0,0 +1,271 @@
+#include <exec/scheduler.hpp>
+#include <exec/context.hpp>
+
+using namespace std;
+using namespace ejdi::exec::value;
+using namespace ejdi::exec::context;
+using namespace ejdi::exec::error;
+using namespace ejdi::exec::isolate;
+
+using Ctx = Context&;
+
+namespace ejdi::exec::scheduler {
+    // Set on pool threads, so tasks spawned by a task go to the worker's
+    // own deque.
+    static thread_local Scheduler* current_scheduler = nullptr;
+    static thread_local size_t current_worker = 0;
+
+
+    string_view Future::type_name() const {
+        return NAME;
+    }
+
+    string_view Future::vtable_name() const {
+        return "Future";
+    }
+
+    shared_ptr<Native> Future::transfer(const shared_ptr<Native>& self, const CopyValue&) const {
+        return self;
+    }
+
+    bool Future::shareable() const {
+        return true;
+    }
+
+    void Future::resolve(Message message) {
+        {
+            auto lock = lock_guard(mutex);
+            result = move(message);
+            done.store(true, memory_order_release);
+        }
+        completed.notify_all();
+    }
+
+    void Future::fail(RuntimeError err) {
+        {
+            auto lock = lock_guard(mutex);
+            error = move(err);
+            done.store(true, memory_order_release);
+        }
+        completed.notify_all();
+    }
+
+    bool Future::is_done() const {
+        return done.load(memory_order_acquire);
+    }
+
+    void Future::wait_for(chrono::milliseconds timeout) {
+        auto lock = unique_lock(mutex);
+        completed.wait_for(lock, timeout, [this]() { return is_done(); });
+    }
+
+    Value Future::take(Ctx ctx) {
+        auto lock = lock_guard(mutex);
+        if (error.has_value()) {
+            throw *error;
+        } else if (!result.has_value()) {
+            throw ctx.error("future was already awaited");
+        }
+
+        auto message = move(*result);
+        result.reset();
+        return attach(ctx, move(message));
+    }
+
+
+    Scheduler::Scheduler(Shared& shared, size_t threads) : shared(shared) {
+        for (size_t i = 0; i < threads; i++) {
+            workers.push_back(make_unique<Worker>());
+        }
+        for (size_t i = 0; i < threads; i++) {
+            workers[i]->thread = thread([this, i]() { work(i); });
+        }
+    }
+
+    Scheduler::~Scheduler() {
+        {
+            auto lock = lock_guard(idle_mutex);
+            stopping.store(true);
+        }
+        idle.notify_all();
+
+        for (auto& worker : workers) {
+            worker->thread.join();
+        }
+    }
+
+    size_t Scheduler::size() const {
+        return workers.size();
+    }
+
+    void Scheduler::submit(Task task) {
+        size_t index;
+        if (current_scheduler == this) {
+            index = current_worker;
+        } else {
+            index = next_worker.fetch_add(1, memory_order_relaxed) % workers.size();
+        }
+
+        {
+            auto& worker = *workers[index];
+            auto lock = lock_guard(worker.mutex);
+            worker.tasks.push_back(move(task));
+        }
+
+        {
+            auto lock = lock_guard(idle_mutex);
+            queued.fetch_add(1);
+        }
+        idle.notify_one();
+    }
+
+    optional<Task> Scheduler::take(optional<size_t> own) {
+        if (queued.load() == 0) {
+            return nullopt;
+        }
+
+        if (own.has_value()) {
+            auto& worker = *workers[*own];
+            auto lock = lock_guard(worker.mutex);
+            if (!worker.tasks.empty()) {
+                auto task = move(worker.tasks.back());
+                worker.tasks.pop_back();
+                queued.fetch_sub(1);
+                return task;
+            }
+        }
+
+        auto start = own.value_or(0) + 1;
+        for (size_t i = 0; i < workers.size(); i++) {
+            auto& victim = *workers[(start + i) % workers.size()];
+            auto lock = lock_guard(victim.mutex);
+            if (!victim.tasks.empty()) {
+                auto task = move(victim.tasks.front());
+                victim.tasks.pop_front();
+                queued.fetch_sub(1);
+                return task;
+            }
+        }
+
+        return nullopt;
+    }
+
+    void Scheduler::run(GlobalContext& global, Task task) {
+        // tasks only see their arguments and the prelude; module-level
+        // names of the spawning module live in another heap
+        auto scope = make_shared<Object>(global.core->get("prelude").as<Object>());
+        auto ctx = Context { global, move(scope), move(task.module_path) };
+
+        try {
+            auto args = attach(ctx, move(task.args));
+            auto result = task.func->call(ctx, move(*args.as<Array>()));
+            task.future->resolve(detach(ctx, move(result)));
+        } catch (RuntimeError& e) {
+            task.future->fail(move(e));
+        } catch (exception& e) {
+            // anything else (bad_alloc, ...) would terminate the worker;
+            // hand it to whoever awaits the future instead
+            task.future->fail(ctx.error(e.what()));
+        }
+    }
+
+    void Scheduler::work(size_t index) {
+        current_scheduler = this;
+        current_worker = index;
+
+        // the pool is owned by `shared`, so the workers must not keep it alive
+        auto global = GlobalContext::with_core(shared_ptr<Shared>(shared_ptr<Shared>(), &shared));
+        global.line_serialized_output = true;
+
+        while (true) {
+            auto task = take(index);
+            if (task.has_value()) {
+                run(global, move(*task));
+                continue;
+            }
+
+            auto lock = unique_lock(idle_mutex);
+            idle.wait(lock, [this]() { return stopping.load() || queued.load() > 0; });
+            if (stopping.load()) {
+                break;
+            }
+        }
+
+        global.close_output();
+    }
+
+    void Scheduler::wait(GlobalContext& global, Future& future) {
+        optional<size_t> own;
+        if (current_scheduler == this) {
+            own = current_worker;
+        }
+
+        while (!future.is_done()) {
+            auto task = take(own);
+            if (task.has_value()) {
+                run(global, move(*task));
+            } else {
+                future.wait_for(chrono::milliseconds(1));
+            }
+        }
+    }
+
+
+    Value await(Ctx ctx, shared_ptr<Future> future) {
+        ctx.global.shared->scheduler().wait(ctx.global, *future);
+        return future->take(ctx);
+    }
+
+    Value prototype() {
+        auto obj = make_shared<Object>();
+        obj->set("to_s",
+                 Function::native_expanded(
+                     [](Ctx) {
+                         return string("[future]");
+                     })
+            );
+        obj->set("done",
+                 Function::native_expanded<Future>(
+                     [](Ctx, auto future) {
+                         return future->is_done();
+                     })
+            );
+        obj->set("await",
+                 Function::native_expanded<Future>(
+                     [](Ctx ctx, auto future) {
+                         return await(ctx, move(future));
+                     })
+            );
+
+        return obj;
+    }
+
+    Value spawn(Ctx ctx, vector<Value> args) {
+        if (args.size() == 0) {
+            throw ctx.arg_count_error(1, 0);
+        }
+
+        auto func = args[0].as<Function>();
+        auto rest = Array(make_move_iterator(next(args.begin())), make_move_iterator(args.end()));
+        auto future = make_shared<Future>();
+
+        ctx.global.shared->scheduler().submit(Task {
+            move(func),
+            detach(ctx, move(rest)),
+            ctx.module_path,
+            future
+        });
+
+        return future;
+    }
+
+    Value join_all(Ctx ctx, shared_ptr<Array> futures) {
+        auto results = make_shared<Array>();
+        results->reserve(futures->size());
+        for (auto& future : *futures) {
+            results->push_back(await(ctx, future.as<Future>()));
+        }
+
+        return results;
+    }
+}
@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+#include <exec/sort.hpp>
+#include <exec/exec.hpp>
+#include <exec/scheduler.hpp>
+
+using namespace std;
+using namespace ejdi::exec::value;
+using namespace ejdi::exec::context;
+using namespace ejdi::exec::isolate;
+using namespace ejdi::exec::scheduler;
+
+using Ctx = Context&;
+
+namespace ejdi::exec::sort {
+    // Arrays up to this size are sorted on the calling thread.
+    static constexpr size_t PARALLEL_ABOVE = 1 << 15;
+    static constexpr size_t MIN_CHUNK = 1 << 13;
+
+    // Sorting works on a permutation of indices, and the elements are only
+    // moved once it's complete, so an error halfway through leaves the
+    // array untouched.
+    using Order = vector<uint32_t>;
+
+    static Order identity(size_t size) {
+        auto order = Order(size);
+        iota(order.begin(), order.end(), 0);
+        return order;
+    }
+
+    static void permute(Array& arr, Array& from, const Order& order) {
+        vector<Value> sorted;
+        sorted.reserve(order.size());
+        for (auto index : order) {
+            sorted.push_back(move(from[index]));
+        }
+
+        static_cast<vector<Value>&>(arr) = move(sorted);
+    }
+
+    // Maps a number to an unsigned integer with the same ordering: negative
+    // numbers get all bits flipped, the others just the sign bit.
+    static uint32_t radix_key(float x) {
+        uint32_t bits;
+        memcpy(&bits, &x, sizeof(bits));
+        return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+    }
+
+    // LSD radix sort of `key << 32 | index`, one byte of the key per pass.
+    // Every pass is stable, so equal numbers keep their order.
+    static Order radix_sort(Array& keys) {
+        auto size = keys.size();
+        vector<uint64_t> items(size);
+        vector<uint64_t> buffer(size);
+        for (size_t i = 0; i < size; i++) {
+            items[i] = uint64_t(radix_key(keys[i].as<float>())) << 32 | i;
+        }
+
+        for (int shift = 32; shift < 64; shift += 8) {
+            size_t counts[256] = {};
+            for (auto item : items) {
+                counts[(item >> shift) & 0xff]++;
+            }
+            // common for the high bytes of small integers
+            if (counts[(items[0] >> shift) & 0xff] == size) {
+                continue;
+            }
+
+            size_t pos = 0;
+            for (auto& count : counts) {
+                auto n = count;
+                count = pos;
+                pos += n;
+            }
+            for (auto item : items) {
+                buffer[counts[(item >> shift) & 0xff]++] = item;
+            }
+            items.swap(buffer);
+        }
+
+        auto order = Order(size);
+        for (size_t i = 0; i < size; i++) {
+            order[i] = uint32_t(items[i]);
+        }
+        return order;
+    }
+
+    // Runs body(0), ..., body(count - 1) on the spawn() pool, body(0) on the
+    // calling thread, and waits for all of them. The bodies must not throw.
+    template< typename F >
+    static void run_on_pool(Ctx ctx, size_t count, const F& body) {
+        auto& scheduler = ctx.global.shared->scheduler();
+
+        vector<shared_ptr<Future>> futures;
+        for (size_t i = 1; i < count; i++) {
+            auto kernel = Function::native(
+                [&body, i](Ctx, vector<Value>) -> Value {
+                    body(i);
+                    return Unit{};
+                }).template as<Function>();
+
+            auto future = make_shared<Future>();
+            scheduler.submit(Task { move(kernel), Message { make_shared<Array>(), {} }, ctx.module_path, future });
+            futures.push_back(move(future));
+        }
+
+        body(0);
+        for (auto& future : futures) {
+            await(ctx, move(future));
+        }
+    }
+
+    // Sorts power-of-two many chunks on the pool, then merges neighbouring
+    // runs pairwise, one level at a time.
+    template< typename Less >
+    static void parallel_merge_sort(Ctx ctx, Order& order, const Less& less) {
+        size_t chunks = 1;
+        auto workers = ctx.global.shared->scheduler().size();
+        while (chunks < workers && order.size() / (chunks * 2) >= MIN_CHUNK) {
+            chunks *= 2;
+        }
+
+        vector<size_t> bounds;
+        for (size_t i = 0; i <= chunks; i++) {
+            bounds.push_back(order.size() * i / chunks);
+        }
+
+        run_on_pool(ctx, chunks, [&](size_t i) {
+            stable_sort(order.begin() + bounds[i], order.begin() + bounds[i + 1], less);
+        });
+
+        auto buffer = Order(order.size());
+        auto* from = &order;
+        auto* to = &buffer;
+        for (size_t width = 1; width < chunks; width *= 2) {
+            run_on_pool(ctx, chunks / (width * 2), [&](size_t i) {
+                auto lo = bounds[i * width * 2];
+                auto mid = bounds[i * width * 2 + width];
+                auto hi = bounds[(i + 1) * width * 2];
+                merge(from->begin() + lo, from->begin() + mid,
+                      from->begin() + mid, from->begin() + hi,
+                      to->begin() + lo, less);
+            });
+            swap(from, to);
+        }
+
+        if (from != &order) {
+            order.swap(buffer);
+        }
+    }
+
+    // Checks that the keys can be ordered without a comparator, and returns
+    // whether they are all numbers.
+    static bool check_keys(Ctx ctx, Array& keys) {
+        auto type = keys[0].value.index();
+        for (auto& key : keys) {
+            if (key.value.index() != type) {
+                throw ctx.error("can't sort values of different types");
+            }
+        }
+
+        auto& first = keys[0];
+        if (first.is<float>()) {
+            return true;
+        } else if (first.is<string>() || first.is<bool>() || first.is<Unit>()) {
+            return false;
+        }
+
+        string msg = "can't sort values of type ";
+        msg += visit([](auto& arg){ return __type_name(&arg); }, first.value);
+        msg += " without a comparator";
+        throw ctx.error(move(msg));
+    }
+
+    static Order sort_keys(Ctx ctx, Array& keys) {
+        if (check_keys(ctx, keys)) {
+            return radix_sort(keys);
+        }
+
+        auto order = identity(keys.size());
+        auto less = [&keys](uint32_t a, uint32_t b) {
+            return compare(keys[a], keys[b]) < 0;
+        };
+
+        if (keys.size() > PARALLEL_ABOVE) {
+            parallel_merge_sort(ctx, order, less);
+        } else {
+            stable_sort(order.begin(), order.end(), less);
+        }
+        return order;
+    }
+
+    static bool check_size(Ctx ctx, Array& arr) {
+        arr.ensure_mutable();
+        if (arr.size() > numeric_limits<uint32_t>::max()) {
+            throw ctx.error("array is too large to sort");
+        }
+        return arr.size() > 1;
+    }
+
+    // Callbacks get a snapshot of the elements, so they can't pull the
+    // array out from under the sort; changing it is reported afterwards.
+    static void check_unchanged(Ctx ctx, Array& arr, size_t size) {
+        arr.ensure_mutable();
+        if (arr.size() != size) {
+            throw ctx.error("array was modified while being sorted");
+        }
+    }
+
+    void sort(Ctx ctx, shared_ptr<Array> arr, shared_ptr<Function> cmp) {
+        if (!check_size(ctx, *arr)) {
+            return;
+        }
+
+        if (cmp == nullptr) {
+            auto order = sort_keys(ctx, *arr);
+            permute(*arr, *arr, order);
+            return;
+        }
+
+        auto elems = Array(*arr);
+        auto order = identity(elems.size());
+        stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return cmp->call(ctx, { elems[a], elems[b] }).as<float>() < 0;
+        });
+
+        check_unchanged(ctx, *arr, elems.size());
+        permute(*arr, elems, order);
+    }
+
+    void sort_by(Ctx ctx, shared_ptr<Array> arr, shared_ptr<Function> key) {
+        if (!check_size(ctx, *arr)) {
+            return;
+        }
+
+        auto elems = Array(*arr);
+        auto keys = Array();
+        keys.reserve(elems.size());
+        for (auto& elem : elems) {
+            keys.push_back(key->call(ctx, { elem }));
+        }
+
+        auto order = sort_keys(ctx, keys);
+
+        check_unchanged(ctx, *arr, elems.size());
+        permute(*arr, elems, order);
+    }
+}
@@ -0,0 +1,127 @@
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include <exec/strings.hpp>
+
+using namespace std;
+using namespace ejdi::exec::value;
+
+namespace ejdi::exec::strings {
+    static constexpr auto npos = string_view::npos;
+
+    size_t find(string_view str, string_view needle, size_t from) {
+        if (from > str.size() || needle.size() > str.size() - from) {
+            return npos;
+        } else if (needle.empty()) {
+            return from;
+        } else if (needle.size() == 1) {
+            auto found = memchr(str.data() + from, needle[0], str.size() - from);
+            return found ? static_cast<const char*>(found) - str.data() : npos;
+        }
+
+        auto last = needle.size() - 1;
+        auto i = from;
+#if defined(__SSE2__)
+        auto first_byte = _mm_set1_epi8(needle[0]);
+        auto last_byte = _mm_set1_epi8(needle[last]);
+        for (; i + last + 16 <= str.size(); i += 16) {
+            auto firsts = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str.data() + i));
+            auto lasts = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str.data() + i + last));
+            unsigned mask = _mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(firsts, first_byte), _mm_cmpeq_epi8(lasts, last_byte)));
+
+            while (mask != 0) {
+                auto pos = i + __builtin_ctz(mask);
+                if (memcmp(str.data() + pos + 1, needle.data() + 1, last - 1) == 0) {
+                    return pos;
+                }
+                mask &= mask - 1;
+            }
+        }
+#endif
+        return str.find(needle, i);
+    }
+
+    size_t rfind(string_view str, string_view needle) {
+        return str.rfind(needle);
+    }
+
+    Array split(string_view str, string_view sep) {
+        Array res;
+        size_t start = 0;
+        for (auto pos = find(str, sep); pos != npos; pos = find(str, sep, start)) {
+            res.push_back(string(str.substr(start, pos - start)));
+            start = pos + sep.size();
+        }
+        res.push_back(string(str.substr(start)));
+        return res;
+    }
+
+    string replace(string_view str, string_view from, string_view to) {
+        string res;
+        size_t start = 0;
+        for (auto pos = find(str, from); pos != npos; pos = find(str, from, start)) {
+            res.append(str.substr(start, pos - start));
+            res.append(to);
+            start = pos + from.size();
+        }
+        res.append(str.substr(start));
+        return res;
+    }
+
+    Array lines(string_view str) {
+        Array res;
+        size_t start = 0;
+        while (start < str.size()) {
+            auto end = find(str, "\n", start);
+            if (end == npos) {
+                end = str.size();
+            }
+
+            auto line = str.substr(start, end - start);
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            res.push_back(string(line));
+            start = end + 1;
+        }
+        return res;
+    }
+
+    static bool is_space(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    string_view trim(string_view str) {
+        while (!str.empty() && is_space(str.front())) {
+            str.remove_prefix(1);
+        }
+        while (!str.empty() && is_space(str.back())) {
+            str.remove_suffix(1);
+        }
+        return str;
+    }
+
+    string upper(string_view str) {
+        string res(str);
+        for (auto& c : res) {
+            if (c >= 'a' && c <= 'z') {
+                c -= 'a' - 'A';
+            }
+        }
+        return res;
+    }
+
+    string lower(string_view str) {
+        string res(str);
+        for (auto& c : res) {
+            if (c >= 'A' && c <= 'Z') {
+                c += 'a' - 'A';
+            }
+        }
+        return res;
+    }
+}
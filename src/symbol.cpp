@@ -0,0 +1,77 @@
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include <symbol.hpp>
+
+using namespace std;
+
+namespace ejdi::symbol {
+    struct Table {
+        shared_mutex mutex;
+        // names never move, so the keys can point into them
+        deque<string> names;
+        unordered_map<string_view, Symbol> symbols;
+    };
+
+    static Table& table() {
+        static Table table;
+        return table;
+    }
+
+    // Each thread remembers the names it has looked up, so lookups by string
+    // don't contend on the table's lock. The keys point into the table's
+    // names as well, so a lookup doesn't allocate.
+    static thread_local unordered_map<string_view, Symbol> cache;
+
+    static const pair<const string_view, Symbol>* find_locked(Table& table, string_view name) {
+        auto iter = table.symbols.find(name);
+        if (iter != table.symbols.end()) {
+            return &*iter;
+        } else {
+            return nullptr;
+        }
+    }
+
+    optional<Symbol> find(string_view name) {
+        auto cached = cache.find(name);
+        if (cached != cache.end()) {
+            return cached->second;
+        }
+
+        auto& t = table();
+        auto lock = shared_lock(t.mutex);
+        auto entry = find_locked(t, name);
+        if (entry == nullptr) {
+            return nullopt;
+        }
+        cache.emplace(*entry);
+        return entry->second;
+    }
+
+    Symbol intern(string_view name) {
+        auto found = find(name);
+        if (found.has_value()) {
+            return *found;
+        }
+
+        auto& t = table();
+        auto lock = unique_lock(t.mutex);
+        auto entry = find_locked(t, name);
+        if (entry == nullptr) {
+            auto symbol = Symbol(t.names.size());
+            t.names.emplace_back(name);
+            entry = &*t.symbols.emplace(t.names.back(), symbol).first;
+        }
+
+        cache.emplace(*entry);
+        return entry->second;
+    }
+
+    const string& name(Symbol symbol) {
+        auto& t = table();
+        auto lock = shared_lock(t.mutex);
+        return t.names[size_t(symbol)];
+    }
+}
@@ -1,3 +1,5 @@
+#include <charconv>
+
 #include <util.hpp>
 
 using namespace std;
@@ -11,4 +13,18 @@ namespace ejdi::util {
     bool starts_with(string_view str, char c) {
         return !str.empty() && str[0] == c;
     }
+
+    optional<float> parse_number(string_view str) {
+        // from_chars takes a minus but no plus sign
+        if (starts_with(str, '+') && !starts_with(str.substr(1), '-')) {
+            str.remove_prefix(1);
+        }
+
+        float res;
+        auto [end, ec] = from_chars(str.data(), str.data() + str.size(), res);
+        if (ec != errc() || end != str.data() + str.size()) {
+            return nullopt;
+        }
+        return res;
+    }
 }
@@ -1,5 +1,11 @@
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <iostream>
+#include <limits>
+#include <unordered_set>
+
+#include <unistd.h>
 
 #include <exec/value.hpp>
 #include <exec/context.hpp>
@@ -7,8 +13,16 @@
 
 using namespace std;
 using namespace ejdi::exec::context;
+using ejdi::symbol::Symbol;
 
 namespace ejdi::exec::value {
+    void Array::ensure_mutable() const {
+        if (frozen) {
+            throw error::RuntimeError { "can't modify a frozen array" };
+        }
+    }
+
+
     Object::Object(shared_ptr<Object> prototype)
         : prototype(move(prototype)) {}
 
@@ -19,16 +33,171 @@ namespace ejdi::exec::value {
         return scope;
     }
 
-    Value* Object::try_get_no_prototype(const string& name) {
-        auto iter = map.find(name);
-        if (iter != map.end()) {
-            return &iter->second;
+    static size_t hash_name(Symbol name) {
+        // Fibonacci hashing; symbols are small consecutive integers
+        return (uint64_t(name) * 0x9e3779b97f4a7c15ull) >> 32;
+    }
+
+    static size_t hash_spelled(string_view name) {
+        return hash<string_view>()(name);
+    }
+
+    size_t Fields::hash_position(size_t position) const {
+        if (names[position] == UNINTERNED) {
+            return hash_spelled(spelled[position]);
+        } else {
+            return hash_name(names[position]);
+        }
+    }
+
+    void Fields::add_to_index(size_t position) {
+        auto mask = index.size() - 1;
+        auto i = hash_position(position) & mask;
+        while (index[i] != 0) {
+            i = (i + 1) & mask;
+        }
+        index[i] = position + 1;
+    }
+
+    // Keeps the index at most half full with `size` fields.
+    void Fields::rebuild_index(size_t size) {
+        auto capacity = size_t(INDEX_ABOVE * 4);
+        while (capacity < size * 2) {
+            capacity *= 2;
+        }
+
+        index.assign(capacity, 0);
+        for (size_t i = 0; i < names.size(); i++) {
+            add_to_index(i);
+        }
+    }
+
+    void Fields::reserve(size_t size) {
+        names.reserve(size);
+        values.reserve(size);
+        if (size > INDEX_ABOVE && index.size() < size * 2) {
+            rebuild_index(size);
+        }
+    }
+
+    void Fields::clear() {
+        names.clear();
+        values.clear();
+        spelled.clear();
+        fill(index.begin(), index.end(), 0);
+    }
+
+    Value* Fields::find(Symbol name) {
+        if (index.empty()) {
+            for (size_t i = 0; i < names.size(); i++) {
+                if (names[i] == name) {
+                    return &values[i];
+                }
+            }
         } else {
+            auto mask = index.size() - 1;
+            for (auto i = hash_name(name) & mask; index[i] != 0; i = (i + 1) & mask) {
+                auto position = index[i] - 1;
+                if (names[position] == name) {
+                    return &values[position];
+                }
+            }
+        }
+
+        // the name may have been interned after the field was added
+        return spelled.empty() ? nullptr : find_uninterned(symbol::name(name));
+    }
+
+    Value* Fields::find(string_view name) {
+        auto symbol = symbol::find(name);
+        return symbol.has_value() ? find(*symbol) : find_uninterned(name);
+    }
+
+    Value* Fields::find_uninterned(string_view name) {
+        if (spelled.empty()) {
             return nullptr;
         }
+
+        if (index.empty()) {
+            for (size_t i = 0; i < names.size(); i++) {
+                if (names[i] == UNINTERNED && spelled[i] == name) {
+                    return &values[i];
+                }
+            }
+            return nullptr;
+        }
+
+        auto mask = index.size() - 1;
+        for (auto i = hash_spelled(name) & mask; index[i] != 0; i = (i + 1) & mask) {
+            auto position = index[i] - 1;
+            if (names[position] == UNINTERNED && spelled[position] == name) {
+                return &values[position];
+            }
+        }
+        return nullptr;
     }
 
-    Value* Object::try_get(const string& name) {
+    void Fields::insert_or_assign(Symbol name, Value value) {
+        auto ptr = find(name);
+        if (ptr != nullptr) {
+            *ptr = move(value);
+            return;
+        }
+
+        if (!spelled.empty()) {
+            spelled.emplace_back();
+        }
+        append(name, move(value));
+    }
+
+    void Fields::insert_or_assign(string_view name, Value value) {
+        auto symbol = symbol::find(name);
+        if (symbol.has_value()) {
+            insert_or_assign(*symbol, move(value));
+            return;
+        }
+
+        auto ptr = find_uninterned(name);
+        if (ptr != nullptr) {
+            *ptr = move(value);
+            return;
+        }
+
+        spelled.resize(names.size());
+        spelled.emplace_back(name);
+        append(UNINTERNED, move(value));
+    }
+
+    const string& Fields::name_string(size_t i) const {
+        if (names[i] == UNINTERNED) {
+            return spelled[i];
+        } else {
+            return symbol::name(names[i]);
+        }
+    }
+
+    void Fields::append(Symbol name, Value value) {
+        names.push_back(name);
+        values.push_back(move(value));
+        if (names.size() > INDEX_ABOVE || !index.empty()) {
+            if (names.size() * 2 > index.size()) {
+                rebuild_index(names.size());
+            } else {
+                add_to_index(names.size() - 1);
+            }
+        }
+    }
+
+
+    Value* Object::try_get_no_prototype(Symbol name) {
+        return fields.find(name);
+    }
+
+    Value* Object::try_get_no_prototype(const string& name) {
+        return fields.find(string_view(name));
+    }
+
+    Value* Object::try_get(Symbol name) {
         auto ptr = try_get_no_prototype(name);
         if (ptr == nullptr && prototype != nullptr) {
             return prototype->try_get(name);
@@ -37,24 +206,64 @@ namespace ejdi::exec::value {
         }
     }
 
+    Value* Object::try_get(const string& name) {
+        auto symbol = symbol::find(name);
+        if (symbol.has_value()) {
+            return try_get(*symbol);
+        }
+
+        for (auto obj = this; obj != nullptr; obj = obj->prototype.get()) {
+            auto ptr = obj->fields.find_uninterned(name);
+            if (ptr != nullptr) {
+                return ptr;
+            }
+        }
+        return nullptr;
+    }
+
+    Value& Object::get(Symbol name) {
+        auto ptr = try_get(name);
+        if (ptr != nullptr) {
+            return *ptr;
+        } else {
+            throw error::RuntimeError { "field '" + symbol::name(name) + "' not found" };
+        }
+    }
+
     Value& Object::get(const string& name) {
         auto ptr = try_get(name);
         if (ptr != nullptr) {
             return *ptr;
         } else {
-            throw error::RuntimeError { string("field '" + name + "' not found") };
+            throw error::RuntimeError { "field '" + name + "' not found" };
         }
     }
 
+    Function& Object::getf(Symbol name) {
+        return *get(name).as<Function>();
+    }
+
     Function& Object::getf(const string& name) {
         return *get(name).as<Function>();
     }
 
-    void Object::set_no_prototype(string name, Value value) {
-        map.insert_or_assign(move(name), move(value));
+    void Object::set_no_prototype(Symbol name, Value value) {
+        if (frozen) {
+            throw error::RuntimeError { "can't set field '" + symbol::name(name) + "' of a frozen object" };
+        }
+
+        fields.insert_or_assign(name, move(value));
     }
 
-    void Object::set(string name, Value value) {
+    void Object::set_no_prototype(const string& name, Value value) {
+        set_no_prototype(symbol::intern(name), move(value));
+    }
+
+    void Object::set(Symbol name, Value value) {
+        if (frozen) {
+            throw error::RuntimeError { "can't set field '" + symbol::name(name) + "' of a frozen object" };
+        }
+
         auto ptr = try_get_no_prototype(name);
         if (ptr != nullptr) {
             *ptr = move(value);
@@ -67,7 +276,11 @@ namespace ejdi::exec::value {
             }
         }
 
-        map.insert_or_assign(move(name), move(value));
+        fields.insert_or_assign(name, move(value));
+    }
+
+    void Object::set(const string& name, Value value) {
+        set(symbol::intern(name), move(value));
     }
 
 
@@ -84,6 +297,10 @@ namespace ejdi::exec::value {
         return func->call(ctx, move(args));
     }
 
+    const LangFunction* Function::lang_function() const {
+        return dynamic_cast<const LangFunction*>(func.get());
+    }
+
 
     Value NativeFunction::call(Context& ctx, vector<Value> args) {
         return func(ctx, move(args));
@@ -94,7 +311,7 @@ namespace ejdi::exec::value {
         auto func_ctx = ctx.child();
 
         for (size_t i = 0; i < argnames->list.size(); i++) {
-            const string& name = argnames->list[i].str;
+            auto name = argnames->list[i].symbol;
 
             if (i < args.size()) {
                 func_ctx.scope->set_no_prototype(name, move(args[i]));
@@ -111,21 +328,164 @@ namespace ejdi::exec::value {
 #define VTABLE(table) (*ctx.global.core->get(table).as<Object>())
 
         if (val.is<Unit>()) {
-            return VTABLE("Unit");
+            return VTABLE(SYMBOL("Unit"));
         } else if (val.is<float>()) {
-            return VTABLE("Number");
+            return VTABLE(SYMBOL("Number"));
         } else if (val.is<bool>()) {
-            return VTABLE("Boolean");
+            return VTABLE(SYMBOL("Boolean"));
         } else if (val.is<string>()) {
-            return VTABLE("String");
+            return VTABLE(SYMBOL("String"));
         } else if (val.is<Function>()) {
-            return VTABLE("Function");
+            return VTABLE(SYMBOL("Function"));
         } else if (val.is<Array>()) {
-            return VTABLE("Array");
+            return VTABLE(SYMBOL("Array"));
+        } else if (val.is<Native>()) {
+            return VTABLE(string(val.as<Native>()->vtable_name()));
         } else {
             return *val.as<Object>();
         }
 
 #undef VTABLE
     }
+
+    Value& lookup(Context& ctx, Value& val, Symbol name) {
+        auto& vtable = get_vtable(ctx, val);
+        auto ptr = vtable.try_get(name);
+        if (ptr != nullptr) {
+            return *ptr;
+        }
+
+        auto obj = &vtable;
+        while (obj->prototype != nullptr) {
+            obj = obj->prototype.get();
+        }
+        if (obj->core_prototype.has_value()) {
+            ptr = ctx.global.core->get(*obj->core_prototype).as<Object>()->try_get(name);
+            if (ptr != nullptr) {
+                return *ptr;
+            }
+        }
+
+        throw error::RuntimeError { "field '" + symbol::name(name) + "' not found" };
+    }
+
+    shared_ptr<Function> lookupf(Context& ctx, Value& val, Symbol name) {
+        return lookup(ctx, val, name).as<Function>();
+    }
+
+    // The name under which `obj` is a built-in prototype, if it is one.
+    static optional<Symbol> core_name(Context& ctx, const shared_ptr<Object>& obj) {
+        auto& core = ctx.global.core->fields;
+        for (size_t i = 0; i < core.size(); i++) {
+            auto& field = core.value(i);
+            if (field.is<Object>() && field.as<Object>() == obj) {
+                return core.name(i);
+            }
+        }
+
+        return nullopt;
+    }
+
+    shared_ptr<string> char_string(char c) {
+        thread_local array<shared_ptr<string>, 256> cache;
+
+        auto& str = cache[static_cast<unsigned char>(c)];
+        if (str == nullptr) {
+            str = make_shared<string>(1, c);
+        }
+        return str;
+    }
+
+    size_t to_index(Context& ctx, float x, size_t end, const char* error) {
+        // compared in double so `end` converts exactly enough, and
+        // negated so NaN fails too
+        if (!(x >= 0 && double(x) < double(end))) {
+            throw ctx.error(error);
+        }
+        return size_t(x);
+    }
+
+    size_t to_capacity(Context& ctx, float x, size_t element_size, const char* error) {
+        static const size_t memory = []() {
+            auto pages = sysconf(_SC_PHYS_PAGES);
+            auto page_size = sysconf(_SC_PAGESIZE);
+            if (pages <= 0 || page_size <= 0) {
+                return numeric_limits<size_t>::max();
+            }
+            return size_t(pages) * size_t(page_size);
+        }();
+
+        return to_index(ctx, x, memory / element_size + 1, error);
+    }
+
+    // Finds natives that can't be shared before freeze() changes anything.
+    struct FreezeCheck {
+        Context& ctx;
+        unordered_set<const void*> seen;
+
+        void check(Value& val) {
+            if (val.is<Array>()) {
+                auto& arr = val.as<Array>();
+                if (arr->frozen || !seen.insert(arr.get()).second) {
+                    return;
+                }
+                for (auto& elem : *arr) {
+                    check(elem);
+                }
+            } else if (val.is<Object>()) {
+                auto obj = val.as<Object>();
+                while (obj != nullptr && !obj->frozen && !core_name(ctx, obj).has_value()) {
+                    if (!seen.insert(obj.get()).second) {
+                        return;
+                    }
+                    for (size_t i = 0; i < obj->fields.size(); i++) {
+                        check(obj->fields.value(i));
+                    }
+                    obj = obj->prototype;
+                }
+            } else if (val.is<Native>() && !val.as<Native>()->shareable()) {
+                string msg = "a ";
+                msg += val.as<Native>()->type_name();
+                msg += " can't be frozen";
+                throw ctx.error(move(msg));
+            }
+        }
+    };
+
+    static void freeze_unchecked(Context& ctx, Value& val) {
+        if (val.is<Array>()) {
+            auto& arr = val.as<Array>();
+            if (arr->frozen) {
+                return;
+            }
+
+            arr->frozen = true;
+            for (auto& elem : *arr) {
+                freeze_unchecked(ctx, elem);
+            }
+        } else if (val.is<Object>()) {
+            auto obj = val.as<Object>();
+            while (obj != nullptr && !obj->frozen && !core_name(ctx, obj).has_value()) {
+                obj->frozen = true;
+                for (size_t i = 0; i < obj->fields.size(); i++) {
+                    freeze_unchecked(ctx, obj->fields.value(i));
+                }
+
+                if (obj->prototype != nullptr) {
+                    auto name = core_name(ctx, obj->prototype);
+                    if (name.has_value()) {
+                        obj->core_prototype = name;
+                        obj->prototype = nullptr;
+                    }
+                }
+
+                obj = obj->prototype;
+            }
+        }
+    }
+
+    void freeze(Context& ctx, Value& val) {
+        FreezeCheck { ctx }.check(val);
+        freeze_unchecked(ctx, val);
+    }
 }
@@ -0,0 +1,19 @@
+#!/bin/sh
+# Runs every script in this directory with the given ejdi binary (./ejdi by
+# default). Each script first prints the error it expects and must then end
+# with that error, which test.ejdi can't check since nothing catches errors.
+ejdi=${1:-./ejdi}
+dir=$(dirname "$0")
+failed=0
+for script in "$dir"/*.ejdi; do
+    expected=$(sed -n 's/^print("expected error: \(.*\)\\n");$/\1/p' "$script")
+    errors=$("$ejdi" "$script" 2>&1 >/dev/null)
+    status=$?
+    if [ -z "$expected" ] || [ $status -ne 1 ] || ! printf '%s\n' "$errors" | grep -qF -- "$expected"; then
+        echo "FAIL $script: exit status $status, expected error: $expected"
+        printf '%s\n' "$errors"
+        failed=$((failed + 1))
+    fi
+done
+echo "$failed failed scripts"
+[ $failed -eq 0 ]